@@ -31,15 +31,250 @@
 #define EXECUTABLE_NAME "./excel-cli"
 #endif
 
+// The tests run every input/*.csv and test/*.csv, and every command line in test/*.args, like
+// `--cells A0 test/cycles.csv`, with the output file added. The outputs and errors are compared
+// with test/expected/<name>.out and test/expected/<name>.err where those exist, a run with only
+// the errors expected must fail. Incremental runs must give the output of a full run: the state
+// of test/<name>.csv with test/<name>.patch applied, the output of test/<name>-patched.csv, and
+// the state of test/<name>.csv run on test/<name>-changed.csv, the output of the latter.
+// The inputs expected to evaluate without errors must compile to programs printing the same output.
+#ifdef _WIN32
+#define CC "gcc"
+#else
+#define CC "cc"
+#endif
+
+#define TEST_DIR "test"
+#define EXPECTED_DIR "test/expected"
+#define TEST_OUT_DIR "out/test"
+
+// Modes that must give every input exactly the output and errors of the default evaluation
+static const char *test_modes[][4] = {
+    { "--jit", NULL },
+    { "--jobs", "4", NULL },
+    { "--jit", "--jobs", "4", NULL },
+};
+
+bool files_equal(const char *actual_path, const char *expected_path)
+{
+    Nob_String_Builder actual = {0};
+    Nob_String_Builder expected = {0};
+    bool result = nob_read_entire_file(actual_path, &actual) && nob_read_entire_file(expected_path, &expected);
+    if (result && (actual.count != expected.count ||
+                   (actual.count > 0 && memcmp(actual.items, expected.items, actual.count) != 0))) {
+        nob_log(NOB_ERROR, "%s differs from %s", actual_path, expected_path);
+        result = false;
+    }
+    nob_sb_free(actual);
+    nob_sb_free(expected);
+    return result;
+}
+
+// Runs the command with stdin from in_path when it is not NULL, stdout to out_path and stderr to err_path
+bool run_redirected(Nob_Cmd *cmd, const char *in_path, const char *out_path, const char *err_path)
+{
+    Nob_Fd fdin = in_path ? nob_fd_open_for_read(in_path) : NOB_INVALID_FD;
+    Nob_Fd fdout = nob_fd_open_for_write(out_path);
+    Nob_Fd fderr = nob_fd_open_for_write(err_path);
+    if ((in_path && fdin == NOB_INVALID_FD) || fdout == NOB_INVALID_FD || fderr == NOB_INVALID_FD) return false;
+    return nob_cmd_run_sync_redirect_and_reset(cmd, (Nob_Cmd_Redirect) {
+        .fdin = in_path ? &fdin : NULL,
+        .fdout = &fdout,
+        .fderr = &fderr,
+    });
+}
+
+// Runs the built binary on the input, its output going to out_path and its errors to err_path
+bool run_cli(Nob_Cmd *cmd, const char *input, const char *out_path, const char *err_path)
+{
+    nob_cmd_append(cmd, input, out_path);
+    return run_redirected(cmd, NULL, TEST_OUT_DIR"/stdout.txt", err_path);
+}
+
+// Compares a run with the expected output and errors of the name
+bool check_expected(bool ran, const char *name, const char *out_path, const char *err_path)
+{
+    const char *expected_out = nob_temp_sprintf(EXPECTED_DIR"/%s.out", name);
+    const char *expected_err = nob_temp_sprintf(EXPECTED_DIR"/%s.err", name);
+    bool has_out = nob_file_exists(expected_out) == 1;
+    bool has_err = nob_file_exists(expected_err) == 1;
+
+    if (!has_out && has_err) {
+        if (ran) nob_log(NOB_ERROR, "%s is expected to fail", name);
+        else nob_log(NOB_INFO, "%s fails as expected", name);
+        return !ran && files_equal(err_path, expected_err);
+    }
+    bool result = ran;
+    if (result && has_out && !files_equal(out_path, expected_out)) result = false;
+    if (result && has_err && !files_equal(err_path, expected_err)) result = false;
+    return result;
+}
+
+bool test_input(const char *input, const char *name)
+{
+    Nob_Cmd cmd = {0};
+    const char *out_path = nob_temp_sprintf(TEST_OUT_DIR"/%s.out", name);
+    const char *err_path = nob_temp_sprintf(TEST_OUT_DIR"/%s.err", name);
+
+    nob_cmd_append(&cmd, EXECUTABLE_NAME);
+    bool ran = run_cli(&cmd, input, out_path, err_path);
+    bool result = check_expected(ran, name, out_path, err_path);
+
+    for (size_t i = 0; ran && i < NOB_ARRAY_LEN(test_modes); ++i) {
+        const char *mode_out = nob_temp_sprintf(TEST_OUT_DIR"/%s.mode%zu.out", name, i);
+        const char *mode_err = nob_temp_sprintf(TEST_OUT_DIR"/%s.mode%zu.err", name, i);
+        nob_cmd_append(&cmd, EXECUTABLE_NAME);
+        for (size_t j = 0; test_modes[i][j] != NULL; ++j) nob_cmd_append(&cmd, test_modes[i][j]);
+        if (!run_cli(&cmd, input, mode_out, mode_err) ||
+            !files_equal(mode_out, out_path) || !files_equal(mode_err, err_path)) result = false;
+    }
+
+    // Only the tables without errors compile, the big ones have no expected output
+    if (ran && nob_file_exists(nob_temp_sprintf(EXPECTED_DIR"/%s.out", name)) == 1 &&
+        nob_file_exists(nob_temp_sprintf(EXPECTED_DIR"/%s.err", name)) != 1) {
+        const char *c_path = nob_temp_sprintf(TEST_OUT_DIR"/%s.c", name);
+        const char *program = nob_temp_sprintf(TEST_OUT_DIR"/%s", name);
+        const char *compiled_out = nob_temp_sprintf(TEST_OUT_DIR"/%s.compiled.out", name);
+        nob_cmd_append(&cmd, EXECUTABLE_NAME, "compile");
+        bool compiled = run_cli(&cmd, input, c_path, TEST_OUT_DIR"/stderr.txt");
+        if (compiled) {
+            nob_cmd_append(&cmd, CC, "-o", program, c_path, "-lm");
+            compiled = nob_cmd_run_sync_and_reset(&cmd);
+        }
+        // Without numbers on stdin the program keeps the values of the sheet
+        if (compiled) {
+            nob_cmd_append(&cmd, program);
+            compiled = run_redirected(&cmd, TEST_OUT_DIR"/empty.txt", compiled_out, TEST_OUT_DIR"/stderr.txt");
+        }
+        if (!compiled || !files_equal(compiled_out, out_path)) result = false;
+    }
+
+    nob_cmd_free(cmd);
+    return result;
+}
+
+bool test_args(const char *path, const char *name)
+{
+    Nob_String_Builder args = {0};
+    if (!nob_read_entire_file(path, &args)) return false;
+
+    Nob_Cmd cmd = {0};
+    nob_cmd_append(&cmd, EXECUTABLE_NAME);
+    Nob_String_View rest = nob_sv_trim(nob_sv_from_parts(args.items, args.count));
+    while (rest.count > 0) {
+        Nob_String_View arg = nob_sv_chop_by_delim(&rest, ' ');
+        rest = nob_sv_trim_left(rest);
+        nob_cmd_append(&cmd, nob_temp_sv_to_cstr(arg));
+    }
+    nob_sb_free(args);
+
+    const char *out_path = nob_temp_sprintf(TEST_OUT_DIR"/%s.out", name);
+    const char *err_path = nob_temp_sprintf(TEST_OUT_DIR"/%s.err", name);
+    nob_cmd_append(&cmd, out_path);
+    bool ran = run_redirected(&cmd, NULL, TEST_OUT_DIR"/stdout.txt", err_path);
+    nob_cmd_free(cmd);
+    return check_expected(ran, name, out_path, err_path);
+}
+
+// Runs the changed input with the state saved for the input, with the patch applied if it is not NULL
+bool test_incremental(const char *input, const char *patch, const char *changed, const char *name)
+{
+    Nob_Cmd cmd = {0};
+    const char *state_path = nob_temp_sprintf(TEST_OUT_DIR"/%s.state", name);
+    const char *input_out = nob_temp_sprintf(TEST_OUT_DIR"/%s.input.out", name);
+    const char *full_out = nob_temp_sprintf(TEST_OUT_DIR"/%s.full.out", name);
+    const char *incremental_out = nob_temp_sprintf(TEST_OUT_DIR"/%s.incremental.out", name);
+    const char *err_path = TEST_OUT_DIR"/stderr.txt";
+    if (nob_file_exists(state_path) == 1 && !nob_delete_file(state_path)) return false;
+
+    bool result = true;
+    nob_cmd_append(&cmd, EXECUTABLE_NAME);
+    if (!run_cli(&cmd, changed, full_out, err_path)) result = false;
+    nob_cmd_append(&cmd, EXECUTABLE_NAME, "--state", state_path);
+    if (!run_cli(&cmd, input, input_out, err_path)) result = false;
+    nob_cmd_append(&cmd, EXECUTABLE_NAME, "--state", state_path);
+    if (patch) nob_cmd_append(&cmd, "--patch", patch);
+    if (!run_cli(&cmd, patch ? input : changed, incremental_out, err_path) ||
+        !files_equal(incremental_out, full_out)) result = false;
+
+    nob_cmd_free(cmd);
+    return result;
+}
+
+bool test_file(const char *dir, const char *file)
+{
+    Nob_String_View name = nob_sv_from_cstr(file);
+    const char *path = nob_temp_sprintf("%s/%s", dir, file);
+    if (nob_sv_end_with(name, ".csv")) {
+        name.count -= strlen(".csv");
+        const char *name_cstr = nob_temp_sv_to_cstr(name);
+        bool result = test_input(path, name_cstr);
+        if (nob_sv_end_with(name, "-changed")) {
+            name.count -= strlen("-changed");
+            const char *input = nob_temp_sprintf("%s/"SV_Fmt".csv", dir, SV_Arg(name));
+            if (!test_incremental(input, NULL, path, name_cstr)) result = false;
+        }
+        return result;
+    }
+    if (nob_sv_end_with(name, ".args")) {
+        name.count -= strlen(".args");
+        return test_args(path, nob_temp_sv_to_cstr(name));
+    }
+    if (nob_sv_end_with(name, ".patch")) {
+        name.count -= strlen(".patch");
+        const char *input = nob_temp_sprintf("%s/"SV_Fmt".csv", dir, SV_Arg(name));
+        const char *patched = nob_temp_sprintf("%s/"SV_Fmt"-patched.csv", dir, SV_Arg(name));
+        return test_incremental(input, path, patched, nob_temp_sprintf(SV_Fmt".patch", SV_Arg(name)));
+    }
+    return true;
+}
+
+int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(const char **) a, *(const char **) b);
+}
+
+bool test_dir(const char *dir, size_t *failed)
+{
+    Nob_File_Paths children = {0};
+    if (!nob_read_entire_dir(dir, &children)) return false;
+    qsort(children.items, children.count, sizeof(*children.items), compare_paths);
+    for (size_t i = 0; i < children.count; ++i) {
+        if (!test_file(dir, children.items[i])) {
+            nob_log(NOB_ERROR, "FAILED: %s/%s", dir, children.items[i]);
+            *failed += 1;
+        }
+    }
+    nob_da_free(children);
+    return true;
+}
+
+bool run_tests(void)
+{
+    if (!nob_mkdir_if_not_exists("out") || !nob_mkdir_if_not_exists(TEST_OUT_DIR)) return false;
+    if (!nob_write_entire_file(TEST_OUT_DIR"/empty.txt", "", 0)) return false;
+
+    size_t failed = 0;
+    if (!test_dir("input", &failed)) return false;
+    if (nob_file_exists(TEST_DIR) == 1 && !test_dir(TEST_DIR, &failed)) return false;
+
+    if (failed > 0) {
+        nob_log(NOB_ERROR, "%zu tests failed", failed);
+        return false;
+    }
+    nob_log(NOB_INFO, "All tests passed");
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     NOB_GO_REBUILD_URSELF(argc, argv);
     Nob_Cmd cmd = {0};
 
 #ifdef _WIN32
-    nob_cmd_append(&cmd, "gcc", CFLAGS, "-o", BINARY_NAME, "src/main.c");
+    nob_cmd_append(&cmd, "gcc", CFLAGS, "-o", BINARY_NAME, "src/main.c", "-lm");
 #else
-    nob_cmd_append(&cmd, "cc", CFLAGS, "-o", BINARY_NAME, "src/main.c");
+    nob_cmd_append(&cmd, "cc", CFLAGS, "-o", BINARY_NAME, "src/main.c", "-lm", "-lpthread");
 #endif
 
     if (!nob_cmd_run_sync(cmd)) return 1;
@@ -49,6 +284,8 @@ int main(int argc, char **argv)
             Nob_Cmd run = {0};
             nob_cmd_append(&run, EXECUTABLE_NAME, IN_FILE, OUT_FILE);
             if (!nob_cmd_run_sync(run)) return 1;
+        } else if(strcmp(argv[1], "test") == 0) {
+            if (!run_tests()) return 1;
         } else if(strcmp(argv[1], "lldb") == 0) {
             Nob_Cmd lldb = {0};
             nob_cmd_append(&lldb, "lldb", "./excel-cli");
@@ -6,12 +6,34 @@
  * The program reads a CSV file containing expressions and parses them into an expression tree.
  */
 
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <time.h>
+#include <math.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifndef __STDC_NO_ATOMICS__
+#include <stdatomic.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
 
 #define SV_IMPLEMENTATION
 #include "sv.h"
@@ -143,52 +165,145 @@ typedef struct {
     size_t col;
 } Cell_Index;
 
+// Structure representing a relative displacement between two cells
+typedef struct {
+    ptrdiff_t row;
+    ptrdiff_t col;
+} Cell_Offset;
+
+// Type of a value. Integral values are computed with exact 64-bit integer
+// arithmetic and are promoted to doubles only when the arithmetic overflows.
+typedef enum {
+    VALUE_TYPE_DOUBLE = 0, // Floating point number
+    VALUE_TYPE_INT,        // Exact 64-bit integer
+} Value_Type;
+
 // Union storing different types of expressions
 typedef union {
-    double number;
+    double number;      // Numeric constant of the type VALUE_TYPE_DOUBLE
+    int64_t integer;    // Numeric constant of the type VALUE_TYPE_INT
     Cell_Index cell;
     Expr_Bop bop;
     Expr_Uop uop;
 } Expr_As;
 
 // Structure representing an expression
+// Expressions hold no pointers, so they can be cached on disk and mapped back as they are.
+// Shared nodes stand for every place they occur, so they keep no place in the source file:
+// errors are located by the cells holding the formulas.
 struct Expr {
     Expr_Kind kind;  // Type of the expression
+    Value_Type type; // Inferred type of the value of the expression
     Expr_As as;      // Expression data
-    const char *file_path; // File path for error tracking
-    size_t file_row; // Row in the source file
-    size_t file_col; // Column in the source file
 };
 
-// Buffer to store and manage expressions dynamically
+// Expression nodes are allocated in fixed-size pages which are never moved,
+// so growing the buffer never copies nodes and node addresses stay stable.
+#define EXPR_PAGE_BITS 16
+#define EXPR_PAGE_CAPACITY ((size_t) 1 << EXPR_PAGE_BITS)
+#define EXPR_PAGE_MASK (EXPR_PAGE_CAPACITY - 1)
+
+// Size of a transparent huge page used to back the pages on request
+#define EXPR_HUGE_PAGE_SIZE ((size_t) 2 * 1024 * 1024)
+
+static_assert(sizeof(Expr) * EXPR_PAGE_CAPACITY <= EXPR_HUGE_PAGE_SIZE, 
+    "A page of expressions must fit into a single huge page.\n");
+
+// Buffer to store and manage expressions dynamically.
+// Nodes are hash-consed: structurally identical nodes are stored only once,
+// so the buffer forms a DAG in which equal subtrees share the same index.
 typedef struct {
-    size_t count;    // Number of expressions stored
-    size_t capacity; // Total capacity of the buffer
-    Expr *items;     // Array of expressions
+    size_t count;          // Number of expressions stored
+    Expr **pages;          // Pages of EXPR_PAGE_CAPACITY expressions each
+    size_t pages_count;    // Number of allocated pages
+    size_t pages_capacity; // Capacity of the page table
+    size_t pages_borrowed; // Number of leading pages owned by someone else, e.g. a mapped cache
+    bool huge_pages;       // Back the pages with transparent huge pages where supported
+
+    size_t *interned;          // Open addressing table of node indices plus one, 0 marks an empty slot
+    size_t interned_capacity;  // Number of slots in the interning table (power of two)
 } Expr_Buffer;
 
+/**
+ * Allocates memory for a single page of expressions.
+ * When huge pages are requested the page is mapped aligned to a huge page
+ * boundary and advised to be backed by a transparent huge page.
+ *
+ * @param huge_pages Whether to back the page with a huge page.
+ * @return Pointer to the allocated page.
+ */
+Expr *expr_page_alloc(bool huge_pages)
+{
+#ifdef MADV_HUGEPAGE
+    if(huge_pages) {
+        // Over-map to be able to trim the mapping down to an aligned huge page
+        size_t size = EXPR_HUGE_PAGE_SIZE;
+        char *mapping = mmap(NULL, 2 * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mapping == MAP_FAILED) {
+            fprintf(stderr, "ERROR: could not map a page of expressions: %s\n", strerror(errno));
+            exit(1);
+        }
+
+        char *page = (char *) (((uintptr_t) mapping + size - 1) & ~(uintptr_t) (size - 1));
+        if(page > mapping) munmap(mapping, page - mapping);
+        if(page + size < mapping + 2 * size) munmap(page + size, mapping + 2 * size - (page + size));
+
+        madvise(page, size, MADV_HUGEPAGE);
+        return (Expr *) page;
+    }
+#else
+    (void) huge_pages;
+#endif
+
+    Expr *page = malloc(sizeof(Expr) * EXPR_PAGE_CAPACITY);
+    if(page == NULL) {
+        fprintf(stderr, "ERROR: could not allocate a page of expressions\n");
+        exit(1);
+    }
+    return page;
+}
+
+/**
+ * Releases a single page of expressions.
+ *
+ * @param page Pointer to the page.
+ * @param huge_pages Whether the page was backed by a huge page.
+ */
+void expr_page_free(Expr *page, bool huge_pages)
+{
+#ifdef MADV_HUGEPAGE
+    if(huge_pages) {
+        munmap(page, EXPR_HUGE_PAGE_SIZE);
+        return;
+    }
+#else
+    (void) huge_pages;
+#endif
+
+    free(page);
+}
+
 /**
  * Allocates a new expression in the buffer.
- * Dynamically resizes the buffer if necessary.
+ * Adds a new page if the last one is full; existing nodes are never moved.
  * 
  * @param eb Pointer to the expression buffer.
  * @return The index of the newly allocated expression.
  */
 Expr_Index expr_buffer_alloc(Expr_Buffer *eb) 
 {
-    if(eb->count >= eb->capacity) {
-        if(eb->capacity == 0) {
-            assert(eb->items == NULL);
-            eb->capacity = 128;
-        } else {
-            eb->capacity *= 2;
+    if(eb->count >= eb->pages_count * EXPR_PAGE_CAPACITY) {
+        if(eb->pages_count >= eb->pages_capacity) {
+            eb->pages_capacity = eb->pages_capacity == 0 ? 16 : eb->pages_capacity * 2;
+            eb->pages = realloc(eb->pages, sizeof(*eb->pages) * eb->pages_capacity);
         }
 
-        eb->items = realloc(eb->items, sizeof(Expr) * eb->capacity);
+        eb->pages[eb->pages_count++] = expr_page_alloc(eb->huge_pages);
     }   
 
-    memset(&eb->items[eb->count], 0, sizeof(Expr));
-    return eb->count++;
+    Expr_Index index = eb->count++;
+    memset(&eb->pages[index >> EXPR_PAGE_BITS][index & EXPR_PAGE_MASK], 0, sizeof(Expr));
+    return index;
 }
 
 /**
@@ -198,27 +313,182 @@ Expr_Index expr_buffer_alloc(Expr_Buffer *eb)
  * @param index Index of the expression to retrieve.
  * @return Pointer to the requested expression.
  */
-Expr *expr_buffer_at(Expr_Buffer *eb, Expr_Index index) 
+Expr *expr_buffer_at(const Expr_Buffer *eb, Expr_Index index) 
 {
     assert(index < eb->count);
-    return &eb->items[index];
+    return &eb->pages[index >> EXPR_PAGE_BITS][index & EXPR_PAGE_MASK];
 }
 
 /**
- * Dumps the expression buffer to a file.
+ * Releases all the memory owned by the expression buffer at once.
+ *
+ * @param eb Pointer to the expression buffer.
+ */
+void expr_buffer_free(Expr_Buffer *eb)
+{
+    for(size_t i = eb->pages_borrowed; i < eb->pages_count; ++i) {
+        expr_page_free(eb->pages[i], eb->huge_pages);
+    }
+
+    free(eb->pages);
+    free(eb->interned);
+
+    bool huge_pages = eb->huge_pages;
+    memset(eb, 0, sizeof(*eb));
+    eb->huge_pages = huge_pages;
+}
+
+/**
+ * Hashes the structure of an expression node.
+ * Only the kind and the payload participate, the source location does not.
+ *
+ * @param expr Pointer to the expression.
+ * @return The hash of the node.
+ */
+uint64_t expr_hash(const Expr *expr)
+{
+    uint64_t words[3] = {0};
+    switch(expr->kind) {
+        case EXPR_KIND_NUMBER:
+            memcpy(&words[0], &expr->as.number, sizeof(expr->as.number));
+            words[1] = expr->type;
+            break;
+        case EXPR_KIND_CELL:
+            words[0] = expr->as.cell.row;
+            words[1] = expr->as.cell.col;
+            break;
+        case EXPR_KIND_BOP:
+            words[0] = expr->as.bop.lhs;
+            words[1] = expr->as.bop.rhs;
+            words[2] = expr->as.bop.kind;
+            break;
+        case EXPR_KIND_UOP:
+            words[0] = expr->as.uop.param;
+            words[2] = expr->as.uop.kind;
+            break;
+        default:
+            UNREACHABLE("Unknown expression kind");
+    }
+
+    // FNV-1a over the node's words
+    uint64_t hash = 14695981039346656037ULL ^ (uint64_t) expr->kind;
+    for(size_t i = 0; i < 3; ++i) {
+        hash ^= words[i];
+        hash *= 1099511628211ULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+/**
+ * Compares the structure of two expression nodes.
+ * Numbers are compared bitwise so that 0.0 and -0.0 stay distinct,
+ * and integral constants stay distinct from the floating point ones.
+ *
+ * @param a Pointer to the first expression.
+ * @param b Pointer to the second expression.
+ * @return true if the nodes are structurally identical, false otherwise.
+ */
+bool expr_eq(const Expr *a, const Expr *b)
+{
+    if(a->kind != b->kind) return false;
+
+    switch(a->kind) {
+        case EXPR_KIND_NUMBER:
+            return a->type == b->type && memcmp(&a->as.number, &b->as.number, sizeof(a->as.number)) == 0;
+        case EXPR_KIND_CELL:
+            return a->as.cell.row == b->as.cell.row && a->as.cell.col == b->as.cell.col;
+        case EXPR_KIND_BOP:
+            return a->as.bop.kind == b->as.bop.kind && a->as.bop.lhs == b->as.bop.lhs && a->as.bop.rhs == b->as.bop.rhs;
+        case EXPR_KIND_UOP:
+            return a->as.uop.kind == b->as.uop.kind && a->as.uop.param == b->as.uop.param;
+        default:
+            UNREACHABLE("Unknown expression kind");
+    }
+}
+
+/**
+ * Grows the interning table and reinserts every stored node.
+ *
+ * @param eb Pointer to the expression buffer.
+ */
+void expr_buffer_grow_interned(Expr_Buffer *eb)
+{
+    free(eb->interned);
+    eb->interned_capacity = eb->interned_capacity == 0 ? 256 : eb->interned_capacity * 2;
+    eb->interned = calloc(eb->interned_capacity, sizeof(*eb->interned));
+
+    size_t mask = eb->interned_capacity - 1;
+    for(Expr_Index index = 0; index < eb->count; ++index) {
+        size_t slot = expr_hash(expr_buffer_at(eb, index)) & mask;
+        while(eb->interned[slot] != 0) slot = (slot + 1) & mask;
+        eb->interned[slot] = index + 1;
+    }
+}
+
+/**
+ * Infers the type of the value of an expression node from its children.
+ * A node is integral if all of its inputs are integral. A division is integral too:
+ * the quotient is computed with integers when it is exact, like an overflow the other
+ * cases fall back to doubles. Cell references are assumed to be integral: whether
+ * the referenced cell actually holds an integer is only known when evaluating.
+ *
+ * @param eb Pointer to the expression buffer holding the children of the node.
+ * @param expr Pointer to the expression.
+ * @return The inferred type.
+ */
+Value_Type expr_infer_type(const Expr_Buffer *eb, const Expr *expr)
+{
+    switch(expr->kind) {
+        case EXPR_KIND_NUMBER:
+            return expr->type;
+        case EXPR_KIND_CELL:
+            return VALUE_TYPE_INT;
+        case EXPR_KIND_BOP:
+            if(expr_buffer_at(eb, expr->as.bop.lhs)->type != VALUE_TYPE_INT) return VALUE_TYPE_DOUBLE;
+            return expr_buffer_at(eb, expr->as.bop.rhs)->type;
+        case EXPR_KIND_UOP:
+            return expr_buffer_at(eb, expr->as.uop.param)->type;
+        default:
+            UNREACHABLE("Unknown expression kind");
+    }
+}
+
+/**
+ * Returns the index of a node structurally identical to the given one,
+ * allocating it in the buffer if no such node exists yet.
+ * An existing node keeps the source location it was first created with.
+ * The type of the node is inferred here, its children are always interned before it.
  *
- * @param stream Output file stream.
  * @param eb Pointer to the expression buffer.
- * @param root Root index of the expression tree.
+ * @param expr The node to intern.
+ * @return The index of the interned expression.
  */
-void expr_buffer_dump(FILE *stream, const Expr_Buffer *eb, Expr_Index root) 
+Expr_Index expr_buffer_intern(Expr_Buffer *eb, Expr expr)
 {
-    fwrite(&root, sizeof(root), 1, stream);
-    fwrite(&eb->count, sizeof(eb->count), 1, stream); 
-    fwrite(eb->items, sizeof(Expr), eb->count, stream);
+    if((eb->count + 1) * 2 > eb->interned_capacity) {
+        expr_buffer_grow_interned(eb);
+    }
+
+    expr.type = expr_infer_type(eb, &expr);
+
+    size_t mask = eb->interned_capacity - 1;
+    size_t slot = expr_hash(&expr) & mask;
+    while(eb->interned[slot] != 0) {
+        Expr_Index index = eb->interned[slot] - 1;
+        if(expr_eq(expr_buffer_at(eb, index), &expr)) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    Expr_Index index = expr_buffer_alloc(eb);
+    *expr_buffer_at(eb, index) = expr;
+    eb->interned[slot] = index + 1;
+    return index;
 }
 
-// Enums defining spreadsheet cell types and evaluation status
+// Enums defining spreadsheet cell types
 typedef enum {
     DIR_LEFT = 0, // Direction left
     DIR_RIGHT,    // Direction right
@@ -256,472 +526,5705 @@ const char *cell_kind_as_cstr(Cell_Kind kind)
     }
 }
 
-typedef enum {
-    UNEVALUATED = 0,
-    INPROGRESS,
-    EVALUATED,
-} Eval_Status;
-
+// An expression cell refers to a shared formula template. Clones of the cell
+// reuse the very same template and only shift the offset by which every cell
+// reference of the template is displaced when it is evaluated for this cell.
 typedef struct {
-    Expr_Index index;
-    double value;
+    Expr_Index index;   // Root of the formula template
+    Cell_Offset offset; // Displacement of the template's cell references
 } Cell_Expr;
 
+// Value of a number cell or an evaluated expression cell
 typedef union {
-    String_View text;
-    double number;
-    Cell_Expr expr;
-    Dir clone;
-} Cell_As;
+    double number;      // Value of the type VALUE_TYPE_DOUBLE
+    int64_t integer;    // Value of the type VALUE_TYPE_INT
+} Cell_Value;
 
-// Structure representing a spreadsheet cell
+// Place of a cell in the source file, only needed to report errors
 typedef struct {
-    Cell_Kind kind;
-    Cell_As as;
-    Eval_Status status;
-
     size_t file_row;
     size_t file_col;
-} Cell;
-
-// Table structure representing the spreadsheet
+} Cell_Location;
+
+// Every cell is a NaN-boxed 64-bit word. A number cell or an evaluated expression cell
+// holds its value: the bits of a double, errors included, or of an integer if the cell
+// has the flag CELL_FLAG_INT. Any other cell holds a tag with a 48-bit payload. The tags
+// are the NaNs with the sign bit and the two top bits of the mantissa set, which the
+// arithmetic never produces, and table_set_value keeps the doubles stored out of them.
+#define CELL_TAG_MASK     0xFFFF000000000000ULL
+#define CELL_TAG_SPACE    0xFFFC000000000000ULL // Bits set in every tag
+#define CELL_TAG_BIT      0x0004000000000000ULL // Bit of the mantissa telling the tags from the NaNs of the arithmetic
+#define CELL_TAG_TEXT     0xFFFD000000000000ULL // Text cell, the payload is the index of the text
+#define CELL_TAG_EXPR     0xFFFE000000000000ULL // Expression cell not evaluated yet, the payload is the index of the formula
+#define CELL_TAG_CLONE    0xFFFF000000000000ULL // Clone cell, the payload is the direction
+#define CELL_PAYLOAD_MASK 0x0000FFFFFFFFFFFFULL
+
+// Flags of a cell kept next to its word
+typedef enum {
+    CELL_FLAG_INT        = 1 << 0, // The word holds a value of the type VALUE_TYPE_INT
+    CELL_FLAG_EXPR       = 1 << 1, // The cell is an expression cell, evaluated or not
+    CELL_FLAG_INPROGRESS = 1 << 2, // The cell is on the work stack of the evaluation or on a chain of clones being followed
+    CELL_FLAG_FORMULA    = 1 << 3, // The cell owns an entry of the formulas, even once a cycle has made it an error
+} Cell_Flag;
+
+// Table structure representing the spreadsheet.
+// The cells are stored as a structure of arrays indexed by the row-major position of the
+// cell: a NaN-boxed word and a byte of flags per cell. The texts and the formulas, which
+// do not fit into a word, live in side tables, and the places of the cells in the source
+// file are found again from the lines of the input when an error is reported.
 typedef struct {
-    Cell *cells;
+    uint64_t *words;          // NaN-boxed words of the cells
+    uint8_t *flags;           // Cell_Flag bits of the cells
+    String_View *texts;       // Texts of the text cells, the first one is the empty text
+    size_t texts_count;
+    size_t texts_capacity;
+    Cell_Expr *formulas;      // Formulas of the expression cells, see table_order_formulas
+    uint32_t *formula_indices; // Index of the formula of every expression cell once the formulas are ordered
+    size_t formulas_count;
+    size_t formulas_capacity;
+    String_View *lines;       // Line of every row in the input
     size_t rows;
     size_t cols;
     const char *file_path;
 } Table;
 
+// Excel-style errors a cell may evaluate to instead of a number
+typedef enum {
+    ERROR_KIND_NONE = 0,
+    ERROR_KIND_REF,    // Reference to a cell outside of the table
+    ERROR_KIND_VALUE,  // Reference to a text cell
+    ERROR_KIND_DIV0,   // Division or remainder by zero
+    ERROR_KIND_CYCLE,  // Circular dependency
+    COUNT_ERROR_KINDS,
+} Error_Kind;
+
+// An error is a double holding a quiet NaN with the kind of the error in its payload,
+// so the arithmetic propagates it like any other NaN without checking the operands.
+// The sign bit is ignored, since negating an error flips it.
+#define ERROR_NAN_BITS 0x7FF8E00000000000ULL
+#define ERROR_NAN_MASK 0x7FFFFFFFFFFFFF00ULL
+
 /**
- * Checks if a character is valid for a name.
- * Valid characters are alphanumeric or underscore.
- * 
- * @param c Character to check.
- * @return true if the character is valid for a name, false otherwise.
+ * Prints the kind of an error as Excel displays it.
+ *
+ * @param kind The error kind enum.
+ * @return A string representation of the error.
  */
-bool is_name(char c) 
+const char *error_kind_as_cstr(Error_Kind kind)
 {
-    return isalnum(c) || c == '_';
+    switch(kind) {
+        case ERROR_KIND_REF:
+            return "#REF!";
+        case ERROR_KIND_VALUE:
+            return "#VALUE!";
+        case ERROR_KIND_DIV0:
+            return "#DIV/0!";
+        case ERROR_KIND_CYCLE:
+            return "#CYCLE!";
+        case ERROR_KIND_NONE:
+        case COUNT_ERROR_KINDS:
+        default:
+            UNREACHABLE("Unknown error kind");
+    }
 }
 
 /**
- * Calcualtes the number in the power of n
- * 
- * @param n the power
- * @param num number which will be exponetiated 
- * @return number in the power of n
+ * Encodes an error as a double.
+ *
+ * @param kind Kind of the error.
+ * @return The NaN standing for the error.
  */
-double bin_pow(double num, int n) 
+double error_value(Error_Kind kind)
 {
-    if(n == 0) return 1.0;
-
-    if(n % 2 == 0) {
-        double tmp = bin_pow(num, n / 2);
-        return tmp*tmp;
-    } else {
-        return num * bin_pow(num, n - 1);
-    }
+    uint64_t bits = ERROR_NAN_BITS | (uint64_t) kind;
+    double value = 0.0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
 }
 
-typedef struct {
-    String_View text;
-    const char *file_path;
-    size_t file_row;
-    size_t file_col;
-} Token;
-
-typedef struct {
-    String_View source;
-    const char* file_path;
-    size_t file_row;
-    const char *line_start;
-} Lexer;
-
 /**
- * Gets the current column position within the file for the lexer.
- * Calculated as the offset from the start of the current line.
- * 
- * @param lexer Pointer to the lexer structure.
- * @return The current column position (1-based indexing).
+ * Decodes the error held by a double.
+ *
+ * @param value The double.
+ * @return Kind of the error, ERROR_KIND_NONE if the double is not an error.
  */
-size_t lexer_file_col(const Lexer *lexer) {
-    return lexer->source.data - lexer->line_start + 1;
+Error_Kind value_error(double value)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    if((bits & ERROR_NAN_MASK) != ERROR_NAN_BITS) return ERROR_KIND_NONE;
+    Error_Kind kind = (Error_Kind) (bits & 0xFF);
+    return kind < COUNT_ERROR_KINDS ? kind : ERROR_KIND_NONE;
 }
 
 /**
- * Prints the current location of the lexer in the format "file:row:col: ".
- * Used for error reporting.
- * 
- * @param lexer Pointer to the lexer structure.
- * @param stream Output file stream.
+ * Returns a value as a double.
+ * Integers beyond 2^53 are rounded to the nearest double.
+ *
+ * @param type Type of the value.
+ * @param value The value.
+ * @return The value as a double.
  */
-void lexer_print_loc(const Lexer *lexer, FILE *stream) {
-    fprintf(stream, "%s:%zu:%zu: ", lexer->file_path, lexer->file_row, lexer_file_col(lexer));
+double value_number(Value_Type type, Cell_Value value)
+{
+    return type == VALUE_TYPE_INT ? (double) value.integer : value.number;
 }
 
 /**
- * Copies the next token from the lexer's source.
- * Handles operators, identifiers, and reports errors for unknown tokens.
- * 
- * @param lexer Pointer to the lexer structure.
- * @return The copied token.
+ * Allocates the arrays of an empty table with every cell an empty text.
+ *
+ * @param table Pointer to the table structure with the size set.
  */
-Token lexer_peek_token(Lexer *lexer)
+void table_alloc(Table *table)
 {
-    lexer->source = sv_trim(lexer->source);
-
-    Token token;
-    memset(&token, 0, sizeof(token));
-    token.file_path = lexer->file_path;
-    token.file_row = lexer->file_row;
-    token.file_col = lexer_file_col(lexer);
-
-    if (lexer->source.count == 0) {
-        return token;
+    size_t cells_count = table->rows * table->cols;
+    table->words = malloc(sizeof(*table->words) * (cells_count + 1));
+    for(size_t i = 0; i < cells_count; ++i) {
+        table->words[i] = CELL_TAG_TEXT;
     }
+    table->flags = calloc(cells_count + 1, sizeof(*table->flags));
 
-    if (*lexer->source.data == '+' || 
-        *lexer->source.data == '-' || 
-        *lexer->source.data == '*' || 
-        *lexer->source.data == '/' ||
-        *lexer->source.data == '(' ||
-        *lexer->source.data == ')' ||
-        *lexer->source.data == '^' ||
-        *lexer->source.data == '%'
-    ) {
-        token.text = (String_View) {
-            .count = 1,
-            .data = lexer->source.data
-        };
-        return token;
-    }
+    table->texts_capacity = 16;
+    table->texts = malloc(sizeof(*table->texts) * table->texts_capacity);
+    table->texts[0] = SV("");
+    table->texts_count = 1;
 
-    if (is_name(*lexer->source.data)) {
-        token.text = sv_take_left_while(lexer->source, is_name);
-        return token;
-    }
+    table->formulas = NULL;
+    table->formula_indices = NULL;
+    table->formulas_count = 0;
+    table->formulas_capacity = 0;
 
-    lexer_print_loc(lexer, stderr);
-    fprintf(stderr, "ERROR: unknown token starts with `%c`\n", *lexer->source.data);
-    exit(1);
+    table->lines = calloc(table->rows + 1, sizeof(*table->lines));
 }
 
 /**
- * Extracts the next token from the lexer's source.
- * Handles operators, identifiers, and reports errors for unknown tokens.
- * 
- * @param lexer Pointer to the lexer structure.
- * @return The extracted token.
+ * Releases the arrays of a table.
+ *
+ * @param table Pointer to the table structure.
  */
-Token lexer_next_token(Lexer *lexer)
+void table_free(Table *table)
 {
-    Token token = lexer_peek_token(lexer);
-    sv_chop_left(&lexer->source, token.text.count);
-    return token;
+    free(table->words);
+    free(table->flags);
+    free(table->texts);
+    free(table->formulas);
+    free(table->formula_indices);
+    free(table->lines);
 }
 
-void lexer_expect_no_tokens(Lexer* lexer)
+/**
+ * Returns the kind of a cell.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @return The kind of the cell.
+ */
+Cell_Kind table_kind(const Table *table, size_t cell)
 {
-    Token token = lexer_next_token(lexer);
-    if(token.text.data != NULL) {
-        fprintf(stderr, "%s:%zu:%zu: ERROR: unexpected token `"SV_Fmt"`\n", 
-            token.file_path, 
-            token.file_row, 
-            token.file_col, 
-            SV_Arg(token.text));
-        exit(1);
+    // The flags alone tell the expression cells and the integers, only the rest reads the word
+    if(table->flags[cell] & CELL_FLAG_EXPR) return CELL_KIND_EXPR;
+    if(table->flags[cell] & CELL_FLAG_INT) return CELL_KIND_NUMBER;
+    switch(table->words[cell] & CELL_TAG_MASK) {
+        case CELL_TAG_TEXT:
+            return CELL_KIND_TEXT;
+        case CELL_TAG_CLONE:
+            return CELL_KIND_CLONE;
+        default:
+            return CELL_KIND_NUMBER;
     }
 }
-typedef struct {
-    size_t capacity;
-    char *cstr;
-} Tmp_Cstr;
 
 /**
- * Fills a temporary C-string with the provided data.
- * Ensures the buffer is large enough and null-terminates the string.
- * 
- * @param tc Pointer to the temporary C-string structure.
- * @param data Pointer to the data to copy.
- * @param data_size Size of the data to copy.
- * @return Pointer to the filled C-string.
+ * Checks if a cell is evaluated. Every cell is, but an expression cell
+ * whose word still holds its formula.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @return true if the cell is evaluated, false otherwise.
  */
-char *tmp_cstr_fill(Tmp_Cstr *tc, const char *data, size_t data_size) 
+bool table_evaluated(const Table *table, size_t cell)
 {
-    if(data_size + 1 >= tc->capacity) {
-        tc->capacity = data_size + 1;
-        tc->cstr = realloc(tc->cstr, tc->capacity);
+    return (table->flags[cell] & CELL_FLAG_INT) || (table->words[cell] & CELL_TAG_MASK) != CELL_TAG_EXPR;
+}
+
+/**
+ * Returns the type of the value of a number cell or an evaluated expression cell.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @return The type of the value.
+ */
+Value_Type table_type(const Table *table, size_t cell)
+{
+    return table->flags[cell] & CELL_FLAG_INT ? VALUE_TYPE_INT : VALUE_TYPE_DOUBLE;
+}
+
+/**
+ * Returns the value of a number cell or an evaluated expression cell.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @return The value of the cell, of the type table_type.
+ */
+Cell_Value table_value(const Table *table, size_t cell)
+{
+    Cell_Value value = {0};
+    memcpy(&value, &table->words[cell], sizeof(value));
+    return value;
+}
+
+/**
+ * Returns the value of a number cell or an evaluated expression cell as a double.
+ * Integers beyond 2^53 are rounded to the nearest double.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @return The value of the cell.
+ */
+double table_number(const Table *table, size_t cell)
+{
+    switch(table_kind(table, cell)) {
+        case CELL_KIND_NUMBER:
+        case CELL_KIND_EXPR:
+            assert(table_evaluated(table, cell));
+            return value_number(table_type(table, cell), table_value(table, cell));
+        case CELL_KIND_TEXT:
+        case CELL_KIND_CLONE:
+        default:
+            UNREACHABLE("Only number and expression cells have a numeric value");
+    }
+}
+
+/**
+ * Returns the value of a number cell or an evaluated expression cell of the type VALUE_TYPE_INT.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @return The value of the cell.
+ */
+int64_t table_integer(const Table *table, size_t cell)
+{
+    assert(table_type(table, cell) == VALUE_TYPE_INT);
+    return table_value(table, cell).integer;
+}
+
+/**
+ * Returns the text of a text cell.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @return The text of the cell.
+ */
+String_View table_text(const Table *table, size_t cell)
+{
+    assert(table_kind(table, cell) == CELL_KIND_TEXT);
+    return table->texts[table->words[cell] & CELL_PAYLOAD_MASK];
+}
+
+/**
+ * Returns the direction a clone cell copies its neighbor from.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @return The direction of the clone.
+ */
+Dir table_clone(const Table *table, size_t cell)
+{
+    assert(table_kind(table, cell) == CELL_KIND_CLONE);
+    return (Dir) (table->words[cell] & CELL_PAYLOAD_MASK);
+}
+
+/**
+ * Returns the formula of an expression cell. The formula of a cell not evaluated yet
+ * is indexed by its word, the one of an evaluated cell by the index kept aside by
+ * table_order_formulas.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @return Pointer to the formula of the cell.
+ */
+const Cell_Expr *table_formula(const Table *table, size_t cell)
+{
+    assert(table->flags[cell] & CELL_FLAG_EXPR);
+    if(!(table->flags[cell] & CELL_FLAG_INT) && (table->words[cell] & CELL_TAG_MASK) == CELL_TAG_EXPR) {
+        return &table->formulas[table->words[cell] & CELL_PAYLOAD_MASK];
+    }
+
+    assert(table->formula_indices != NULL);
+    return &table->formulas[table->formula_indices[cell]];
+}
+
+/**
+ * Makes a cell a text cell. All the empty texts share the first entry of the texts.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @param text The text.
+ */
+void table_set_text(Table *table, size_t cell, String_View text)
+{
+    size_t index = 0;
+    if(text.count > 0) {
+        if(table->texts_count >= table->texts_capacity) {
+            table->texts_capacity *= 2;
+            table->texts = realloc(table->texts, sizeof(*table->texts) * table->texts_capacity);
+        }
+        index = table->texts_count++;
+        table->texts[index] = text;
+    }
+    table->words[cell] = CELL_TAG_TEXT | index;
+    table->flags[cell] = 0;
+}
+
+/**
+ * Makes room for more formulas in the table.
+ *
+ * @param table Pointer to the table structure.
+ * @param count Number of the formulas to make room for.
+ */
+void table_reserve_formulas(Table *table, size_t count)
+{
+    if(table->formulas_count + count <= table->formulas_capacity) return;
+    while(table->formulas_count + count > table->formulas_capacity) {
+        table->formulas_capacity = table->formulas_capacity == 0 ? 256 : table->formulas_capacity * 2;
+    }
+    table->formulas = realloc(table->formulas, sizeof(*table->formulas) * table->formulas_capacity);
+}
+
+/**
+ * Makes a cell an expression cell waiting for its evaluation.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @param expr The formula of the cell.
+ */
+void table_set_formula(Table *table, size_t cell, Cell_Expr expr)
+{
+    table_reserve_formulas(table, 1);
+    size_t index = table->formulas_count++;
+    table->formulas[index] = expr;
+    table->words[cell] = CELL_TAG_EXPR | index;
+    table->flags[cell] = CELL_FLAG_EXPR | CELL_FLAG_FORMULA;
+}
+
+/**
+ * Makes a cell a clone cell.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @param dir The direction to copy the neighbor from.
+ */
+void table_set_clone(Table *table, size_t cell, Dir dir)
+{
+    table->words[cell] = CELL_TAG_CLONE | (uint64_t) dir;
+    table->flags[cell] = 0;
+}
+
+/**
+ * Stores the value of a number cell or of an expression cell, which finishes its evaluation.
+ * A NaN that would read as a tag has the second top bit of its mantissa cleared.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @param type Type of the value.
+ * @param value The value.
+ */
+void table_set_value(Table *table, size_t cell, Value_Type type, Cell_Value value)
+{
+    uint64_t word = 0;
+    memcpy(&word, &value, sizeof(word));
+    if(type == VALUE_TYPE_DOUBLE && (word & CELL_TAG_SPACE) == CELL_TAG_SPACE) {
+        word &= ~CELL_TAG_BIT;
+    }
+    table->words[cell] = word;
+    table->flags[cell] = (table->flags[cell] & (CELL_FLAG_EXPR | CELL_FLAG_FORMULA)) | (type == VALUE_TYPE_INT ? CELL_FLAG_INT : 0);
+}
+
+/**
+ * Stores a double as the value of a number cell or of an expression cell, see table_set_value.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @param number The value.
+ */
+void table_set_number(Table *table, size_t cell, double number)
+{
+    table_set_value(table, cell, VALUE_TYPE_DOUBLE, (Cell_Value) { .number = number });
+}
+
+/**
+ * Stores an integer as the value of a number cell or of an expression cell, see table_set_value.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @param integer The value.
+ */
+void table_set_integer(Table *table, size_t cell, int64_t integer)
+{
+    table_set_value(table, cell, VALUE_TYPE_INT, (Cell_Value) { .integer = integer });
+}
+
+/**
+ * Turns a cell into a number cell holding an error.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @param kind Kind of the error.
+ */
+void table_set_error(Table *table, size_t cell, Error_Kind kind)
+{
+    table->flags[cell] &= CELL_FLAG_FORMULA;
+    table_set_number(table, cell, error_value(kind));
+}
+
+/**
+ * Remembers the line of every row of the input, to locate the cells.
+ *
+ * @param table Pointer to the table structure.
+ * @param content Content of the input.
+ */
+void table_index_lines(Table *table, String_View content)
+{
+    for(size_t row = 0; row < table->rows; ++row) {
+        table->lines[row] = sv_chop_by_delim(&content, '\n');
+    }
+}
+
+/**
+ * Finds the place of a cell in the input the same way as the parser splits the rows.
+ *
+ * @param table Pointer to the table structure with the lines indexed.
+ * @param cell Row-major position of the cell.
+ * @return The place of the cell.
+ */
+Cell_Location table_location(const Table *table, size_t cell)
+{
+    size_t row = cell / table->cols;
+    String_View line = table->lines[row];
+    String_View cell_value = {0};
+    for(size_t col = 0; col <= cell % table->cols; ++col) {
+        cell_value = sv_trim(sv_chop_by_delim(&line, '|'));
+    }
+    return (Cell_Location) {
+        .file_row = row + 1,
+        .file_col = cell_value.data - table->lines[row].data + 1,
+    };
+}
+
+/**
+ * Formats the value of a number cell or an evaluated expression cell.
+ * Integers are printed exactly but in the same format as the doubles, errors as Excel displays them.
+ *
+ * @param buffer Buffer to format into, may be NULL if size is 0.
+ * @param size Size of the buffer.
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell.
+ * @return The length of the formatted value, like snprintf.
+ */
+int table_snprint_number(char *buffer, size_t size, const Table *table, size_t cell)
+{
+    if(table_type(table, cell) == VALUE_TYPE_INT) {
+        return snprintf(buffer, size, "%" PRId64 ".000000", table_integer(table, cell));
+    }
+    double number = table_number(table, cell);
+    Error_Kind error = value_error(number);
+    if(error != ERROR_KIND_NONE) {
+        return snprintf(buffer, size, "%s", error_kind_as_cstr(error));
+    }
+    return snprintf(buffer, size, "%lf", number);
+}
+
+/**
+ * Checks if a character is valid for a name.
+ * Valid characters are alphanumeric or underscore.
+ * 
+ * @param c Character to check.
+ * @return true if the character is valid for a name, false otherwise.
+ */
+bool is_name(char c) 
+{
+    return isalnum(c) || c == '_';
+}
+
+/**
+ * Calcualtes the number in the power of n
+ * 
+ * @param n the power
+ * @param num number which will be exponetiated 
+ * @return number in the power of n
+ */
+double bin_pow(double num, int64_t n) 
+{
+    if(n == 0) return 1.0;
+    // Negating n + 1 rather than n does not overflow for INT64_MIN
+    if(n < 0) return 1.0 / (num * bin_pow(num, -(n + 1)));
+
+    if(n % 2 == 0) {
+        double tmp = bin_pow(num, n / 2);
+        return tmp*tmp;
+    } else {
+        return num * bin_pow(num, n - 1);
+    }
+}
+
+typedef struct {
+    String_View text;
+    const char *file_path;
+    size_t file_row;
+    size_t file_col;
+} Token;
+
+typedef struct {
+    String_View source;
+    const char* file_path;
+    size_t file_row;
+    const char *line_start;
+} Lexer;
+
+/**
+ * Gets the current column position within the file for the lexer.
+ * Calculated as the offset from the start of the current line.
+ * 
+ * @param lexer Pointer to the lexer structure.
+ * @return The current column position (1-based indexing).
+ */
+size_t lexer_file_col(const Lexer *lexer) {
+    return lexer->source.data - lexer->line_start + 1;
+}
+
+/**
+ * Prints the current location of the lexer in the format "file:row:col: ".
+ * Used for error reporting.
+ * 
+ * @param lexer Pointer to the lexer structure.
+ * @param stream Output file stream.
+ */
+void lexer_print_loc(const Lexer *lexer, FILE *stream) {
+    fprintf(stream, "%s:%zu:%zu: ", lexer->file_path, lexer->file_row, lexer_file_col(lexer));
+}
+
+/**
+ * Copies the next token from the lexer's source.
+ * Handles operators, identifiers, and reports errors for unknown tokens.
+ * 
+ * @param lexer Pointer to the lexer structure.
+ * @return The copied token.
+ */
+Token lexer_peek_token(Lexer *lexer)
+{
+    lexer->source = sv_trim(lexer->source);
+
+    Token token;
+    memset(&token, 0, sizeof(token));
+    token.file_path = lexer->file_path;
+    token.file_row = lexer->file_row;
+    token.file_col = lexer_file_col(lexer);
+
+    if (lexer->source.count == 0) {
+        return token;
+    }
+
+    if (*lexer->source.data == '+' || 
+        *lexer->source.data == '-' || 
+        *lexer->source.data == '*' || 
+        *lexer->source.data == '/' ||
+        *lexer->source.data == '(' ||
+        *lexer->source.data == ')' ||
+        *lexer->source.data == '^' ||
+        *lexer->source.data == '%'
+    ) {
+        token.text = (String_View) {
+            .count = 1,
+            .data = lexer->source.data
+        };
+        return token;
+    }
+
+    if (is_name(*lexer->source.data)) {
+        token.text = sv_take_left_while(lexer->source, is_name);
+        return token;
+    }
+
+    lexer_print_loc(lexer, stderr);
+    fprintf(stderr, "ERROR: unknown token starts with `%c`\n", *lexer->source.data);
+    exit(1);
+}
+
+/**
+ * Extracts the next token from the lexer's source.
+ * Handles operators, identifiers, and reports errors for unknown tokens.
+ * 
+ * @param lexer Pointer to the lexer structure.
+ * @return The extracted token.
+ */
+Token lexer_next_token(Lexer *lexer)
+{
+    Token token = lexer_peek_token(lexer);
+    sv_chop_left(&lexer->source, token.text.count);
+    return token;
+}
+
+void lexer_expect_no_tokens(Lexer* lexer)
+{
+    Token token = lexer_next_token(lexer);
+    if(token.text.data != NULL) {
+        fprintf(stderr, "%s:%zu:%zu: ERROR: unexpected token `"SV_Fmt"`\n", 
+            token.file_path, 
+            token.file_row, 
+            token.file_col, 
+            SV_Arg(token.text));
+        exit(1);
+    }
+}
+typedef struct {
+    size_t capacity;
+    char *cstr;
+} Tmp_Cstr;
+
+/**
+ * Fills a temporary C-string with the provided data.
+ * Ensures the buffer is large enough and null-terminates the string.
+ * 
+ * @param tc Pointer to the temporary C-string structure.
+ * @param data Pointer to the data to copy.
+ * @param data_size Size of the data to copy.
+ * @return Pointer to the filled C-string.
+ */
+char *tmp_cstr_fill(Tmp_Cstr *tc, const char *data, size_t data_size) 
+{
+    if(data_size + 1 >= tc->capacity) {
+        tc->capacity = data_size + 1;
+        tc->cstr = realloc(tc->cstr, tc->capacity);
+    }
+
+    memcpy(tc->cstr, data, data_size);
+    tc->cstr[data_size] = '\0';
+    return tc->cstr;
+}
+
+/**
+ * Converts a String_View to a double.
+ * Creates a temporary null-terminated string and uses strtod for conversion.
+ * 
+ * @param sv The String_View to convert.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param out Pointer to store the resulting double value.
+ * @return true if conversion succeeded, false otherwise.
+ */
+bool sv_strtod(String_View sv, Tmp_Cstr *tc, double *out)
+{
+    char *ptr = tmp_cstr_fill(tc, sv.data, sv.count);
+    char *endptr = NULL;
+    double result = strtod(ptr, &endptr);
+    if (out) *out = result;
+    return endptr != ptr && *endptr == '\0';
+}
+
+/**
+ * Converts a String_View to a long integer.
+ * Creates a temporary null-terminated string and uses strtol for conversion.
+ * 
+ * @param sv The String_View to convert.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param out Pointer to store the resulting long integer value.
+ * @return true if conversion succeeded, false otherwise.
+ */
+bool sv_strtol(String_View sv, Tmp_Cstr *tc, long int *out)
+{
+    char *ptr = tmp_cstr_fill(tc, sv.data, sv.count);
+    char *endptr = NULL;
+    long int result = strtol(ptr, &endptr, 10);
+    if (out) *out = result;
+    return endptr != ptr && *endptr == '\0';
+}
+
+/**
+ * Converts a String_View to a 64-bit integer.
+ * Creates a temporary null-terminated string and uses strtoll for conversion.
+ * 
+ * @param sv The String_View to convert.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param out Pointer to store the resulting integer value.
+ * @return true if conversion succeeded and the integer is in range, false otherwise.
+ */
+bool sv_strtoll(String_View sv, Tmp_Cstr *tc, int64_t *out)
+{
+    char *ptr = tmp_cstr_fill(tc, sv.data, sv.count);
+    char *endptr = NULL;
+    errno = 0;
+    long long result = strtoll(ptr, &endptr, 10);
+    if (out) *out = (int64_t) result;
+    return endptr != ptr && *endptr == '\0' && errno != ERANGE;
+}
+
+Expr_Index parse_expr(Lexer *lexer, Tmp_Cstr *tc, Expr_Buffer *eb);
+
+/**
+ * Parses a primary expression (number or cell reference).
+ * Handles the most basic elements of expressions.
+ * 
+ * @param lexer Pointer to the lexer structure.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param eb Pointer to the expression buffer.
+ * @return Index of the parsed primary expression.
+ */
+Expr_Index parse_primary_expr(Lexer *lexer, Tmp_Cstr *tc, Expr_Buffer *eb) 
+{
+    Token token = lexer_next_token(lexer);
+
+    if (token.text.count == 0) {
+        lexer_print_loc(lexer, stderr);
+        fprintf(stderr, "ERROR: expected primary expression token, but got end of input\n");
+        exit(1);
+    }
+
+    double number = 0.0;
+    int64_t integer = 0;
+
+    if (sv_strtoll(token.text, tc, &integer)) {
+        Expr expr = {
+            .kind = EXPR_KIND_NUMBER,
+            .type = VALUE_TYPE_INT,
+            .as.integer = integer,
+        };
+        return expr_buffer_intern(eb, expr);
+    } else if (sv_strtod(token.text, tc, &number)) {
+        Expr expr = {
+            .kind = EXPR_KIND_NUMBER,
+            .type = VALUE_TYPE_DOUBLE,
+            .as.number = number,
+        };
+        return expr_buffer_intern(eb, expr);
+    } else if(sv_eq(token.text, SV("("))) {
+        Expr_Index expr_index = parse_expr(lexer, tc, eb);
+        token = lexer_next_token(lexer);
+        if(!sv_eq(token.text, SV(")"))) {
+            fprintf(stderr, "%s:%zu:%zu: ERROR: expected token ')' but got '"SV_Fmt"'\n", 
+                token.file_path, token.file_row, token.file_col, SV_Arg(token.text));
+            exit(1);
+        }
+
+        return expr_index;
+    } else if (sv_eq(token.text, SV("-"))){
+        Expr_Index param_index = parse_expr(lexer, tc, eb);
+        Expr expr = {
+            .kind = EXPR_KIND_UOP,
+            .as.uop.kind = UOP_KIND_MINUS,
+            .as.uop.param = param_index,
+        };
+        return expr_buffer_intern(eb, expr);
+    } else {
+        Expr expr = {
+            .kind = EXPR_KIND_CELL,
+        };
+
+        if (!isupper(*token.text.data)) {
+            lexer_print_loc(lexer, stderr);
+            fprintf(stderr, "ERROR: cell reference must start with capital letter\n");
+            exit(1);
+        }
+
+        expr.as.cell.col = *token.text.data - 'A';
+
+        sv_chop_left(&token.text, 1);
+
+        long int row = 0;
+        if (!sv_strtol(token.text, tc, &row)) {
+            lexer_print_loc(lexer, stderr);
+            fprintf(stderr, "ERROR: cell reference must have an integer as the row number\n" );
+            exit(1);
+        }
+
+        expr.as.cell.row = (size_t) row;
+        return expr_buffer_intern(eb, expr);
+    }
+}
+
+
+/**
+ * Parses an binary operation expression.
+ * Handles expressions with addition operators, recursively parsing the right-hand side.
+ * 
+ * @param lexer Pointer to the lexer structure.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param eb Pointer to the expression buffer.
+ * @param precedence Current precedence of the expression
+ * @return Index of the parsed addition expression or primary expression.
+ */
+Expr_Index parse_bop_expr(Lexer *lexer, Tmp_Cstr *tc, Expr_Buffer *eb, size_t precedence)
+{
+    if (precedence >= COUNT_BOP_PRECEDENCE) {
+        return parse_primary_expr(lexer, tc, eb);
+    }
+
+    Expr_Index lhs_index = parse_bop_expr(lexer, tc, eb, precedence + 1);
+
+    Token token = lexer_peek_token(lexer);
+    const Bop_Def *def = bop_def_by_token(token.text);
+
+    if (def != NULL && def->precedence == precedence) {
+        token = lexer_next_token(lexer);
+        Expr_Index rhs_index = parse_bop_expr(lexer, tc, eb, precedence);
+
+        Expr expr = {
+            .kind = EXPR_KIND_BOP,
+            .as.bop.kind = def->kind,
+            .as.bop.lhs = lhs_index,
+            .as.bop.rhs = rhs_index,
+        };
+
+        return expr_buffer_intern(eb, expr);
+    }
+
+    return lhs_index;
+}
+
+/**
+ * Retrieves the position of a cell in the arrays of the table at a given index.
+ * Verifies the index is within bounds before returning.
+ *
+ * @param table Pointer to the table structure.
+ * @param index Index of the cell to retrieve.
+ * @return Row-major position of the requested cell.
+ */
+size_t table_cell_at(const Table *table, Cell_Index index) 
+{
+    assert(index.row < table->rows);
+    assert(index.col < table->cols);
+
+    return index.row * table->cols + index.col;
+}
+
+/**
+ * Dumps the table contents to an output stream.
+ * Prints each cell's file location and kind.
+ *
+ * @param stream Output file stream.
+ * @param table Pointer to the table structure.
+ */
+void dump_table(FILE *stream, Table *table) 
+{
+    for(size_t row = 0; row < table->rows; ++row) {
+        for(size_t col = 0; col < table->cols; ++col) {
+            Cell_Index cell_index = {
+                .col = col,
+                .row = row,
+            };
+
+            size_t cell = table_cell_at(table, cell_index);
+            Cell_Location location = table_location(table, cell);
+            fprintf(stream, "%s:%zu:%zu: %s\n", table->file_path, location.file_row, location.file_col, cell_kind_as_cstr(table_kind(table, cell)));
+        }
+    }
+}
+
+/**
+ * Recursively prints an expression tree.
+ * Output is indented based on the tree depth to show structure.
+ *
+ * @param stream Output file stream.
+ * @param eb Pointer to the expression buffer.
+ * @param expr_index Index of the expression to dump.
+ * @param level Current nesting level (for indentation).
+ */
+void dump_expr(FILE *stream, Expr_Buffer *eb, Expr_Index expr_index, int level) 
+{
+    fprintf(stream, "%*s", level * 2, "");
+
+    Expr *expr = expr_buffer_at(eb, expr_index);
+    
+    switch(expr->kind) {
+        case EXPR_KIND_NUMBER:
+            if(expr->type == VALUE_TYPE_INT) {
+                fprintf(stream, "NUMBER: %" PRId64 "\n", expr->as.integer);
+            } else {
+                fprintf(stream, "NUMBER: %lf\n", expr->as.number);
+            }
+            break;
+        case EXPR_KIND_CELL:
+            fprintf(stream, "CELL(%zu, %zu)\n", expr->as.cell.row, expr->as.cell.col);
+            break;
+        case EXPR_KIND_UOP:
+            switch(expr->as.uop.kind) {
+                case UOP_KIND_MINUS:
+                    fprintf(stream, "UOP(MINUS): \n");
+                    break;
+                default:
+                    UNREACHABLE("Unknown unary operator kind");
+            }
+
+            dump_expr(stream, eb, expr->as.uop.param, level + 1);
+            break;
+        case EXPR_KIND_BOP:
+            switch(expr->as.bop.kind) {
+                case BOP_KIND_PLUS:
+                    fprintf(stream, "BOP(PLUS): \n");
+                    break;
+                case BOP_KIND_MINUS:
+                    fprintf(stream, "BOP(MINUS): \n");
+                    break;
+                case BOP_KIND_MULT:
+                    fprintf(stream, "BOP(MULT): \n");
+                    break;
+                case BOP_KIND_DIV:
+                    fprintf(stream, "BOP(DIV): \n");
+                    break;
+                case BOP_KIND_POW:
+                    fprintf(stream, "BOP(POW): \n");
+                    break;
+                case BOP_KIND_MOD:
+                    fprintf(stream, "BOP(MOD): \n");
+                    break;
+                case COUNT_BOP_KINDS:
+                default: {
+                    UNREACHABLE("Unknown binary operator kind");
+                }
+            }
+
+            dump_expr(stream, eb, expr->as.bop.lhs, level + 1);
+            dump_expr(stream, eb, expr->as.bop.rhs, level + 1);
+            break;
+        default: {
+            UNREACHABLE("Unknown expression kind");
+        }
+    }
+}
+
+/**
+ * Parses an expression from the given lexer.
+ * This is the entry point for expression parsing.
+ *
+ * @param lexer Pointer to the lexer structure.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param eb Pointer to the expression buffer.
+ * @return Index of the parsed expression.
+ */
+Expr_Index parse_expr(Lexer *lexer, Tmp_Cstr *tc, Expr_Buffer *eb) 
+{
+    return parse_bop_expr(lexer, tc, eb, BOP_PRECEDENCE0);
+}
+
+/**
+ * Prints usage information for the program.
+ * Displays the correct command-line syntax.
+ *
+ * @param stream Output file stream.
+ */
+void print_usage(FILE *stream) 
+{
+    fprintf(stream, "Usage: ./excel-cli [OPTIONS] <input.csv> <output.csv>\n");
+    fprintf(stream, "       ./excel-cli compile [OPTIONS] <input.csv> <output.c>\n");
+    fprintf(stream, "OPTIONS:\n");
+    fprintf(stream, "    --huge-pages    Back expression nodes with transparent huge pages (Linux only)\n");
+    fprintf(stream, "    --jit           Compile formulas to native code (x86-64 only, interpreted elsewhere)\n");
+    fprintf(stream, "    --cache <dir>   Cache the parsed table in <dir>, keyed by the hash of the input\n");
+    fprintf(stream, "    --jobs <n>      Evaluate the cells on <n> threads (serial where threads are not supported)\n");
+    fprintf(stream, "    --state <file>  Save the evaluated table and its reverse dependencies to <file>\n");
+    fprintf(stream, "    --patch <file>  Apply the cell assignments in <file> to the input and recompute only\n");
+    fprintf(stream, "                    the cells they affect, using the --state saved for the input\n");
+    fprintf(stream, "    --cells <list>  Evaluate and print only the cells in <list>, like E6,D2:D10\n");
+    fprintf(stream, "    --columns <list> Evaluate and print only the columns in <list>, like A,C:E,\n");
+    fprintf(stream, "                    and the columns they depend on\n");
+}
+
+/**
+ * Reads the contents of a CSV file into memory.
+ * Allocates memory for the file contents and reads the entire file.
+ *
+ * @param file_path Path to the CSV file.
+ * @param size Pointer to store the size of the file.
+ * @return Pointer to the allocated buffer containing the file contents, or NULL on error.
+ */
+char *read_csv(const char *file_path, size_t *size) 
+{
+
+    char *buffer = NULL;
+    FILE *f = fopen(file_path, "rb");
+    if(f == NULL) {
+        goto error;
+    }
+
+    if(fseek(f, 0, SEEK_END) < 0) goto error;
+
+    long m = ftell(f); // size of file
+    if(m < 0) goto error;
+    
+    buffer = malloc(sizeof(char) * m);
+    if(buffer == NULL) goto error;
+
+    if(fseek(f, 0, SEEK_SET) < 0) goto error;
+    
+    size_t n = fread(buffer, 1, m, f);
+    assert(n == (size_t) m);
+
+    if(ferror(f)) goto error;
+
+    if(size) {
+        *size = n;
+    }
+
+    fclose(f);
+    return buffer;
+
+error:
+    if(f) fclose(f);
+    if(buffer) free(buffer);
+
+    return NULL;
+}
+
+/**
+ * Parses the text of a single cell into the cell: a formula, a clone, a number or a text.
+ * Whatever the cell held before is replaced.
+ *
+ * @param table Pointer to the table structure.
+ * @param cell Row-major position of the cell to fill.
+ * @param eb Pointer to the expression buffer.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param cell_value Trimmed text of the cell.
+ * @param file_path Path to the file the text comes from, for error reporting.
+ * @param file_row Row of the text in the file, for error reporting.
+ * @param line_start Start of the line the text comes from, for error reporting.
+ */
+void parse_cell(Table *table, size_t cell, Expr_Buffer *eb, Tmp_Cstr *tc, String_View cell_value, const char *file_path, size_t file_row, const char *line_start)
+{
+    size_t file_col = cell_value.data - line_start + 1;
+    table->flags[cell] = 0;
+
+    if (sv_starts_with(cell_value, SV("="))) {
+        sv_chop_left(&cell_value, 1);
+        Lexer lexer = {
+            .file_path = file_path,
+            .file_row = file_row,
+            .line_start = line_start,
+            .source = cell_value,
+        };
+        Cell_Expr expr = { .index = parse_expr(&lexer, tc, eb) };
+        lexer_expect_no_tokens(&lexer);
+        table_set_formula(table, cell, expr);
+    } else if(sv_starts_with(cell_value, SV(":"))) {
+        sv_chop_left(&cell_value, 1);
+        if(sv_eq(cell_value, SV("<"))) {
+            table_set_clone(table, cell, DIR_LEFT);
+        } else if(sv_eq(cell_value, SV(">"))) {
+            table_set_clone(table, cell, DIR_RIGHT);
+        } else if(sv_eq(cell_value, SV("^"))) {
+            table_set_clone(table, cell, DIR_UP);
+        } else if(sv_eq(cell_value, SV("v"))) {
+            table_set_clone(table, cell, DIR_DOWN);
+        } else {
+            fprintf(stderr, "%s:%zu:%zu: ERROR: "SV_Fmt" is not a correct direction to clone a cell from \n", file_path, file_row, file_col, SV_Arg(cell_value));
+            exit(1);
+        }
+    } else {
+        Cell_Value value = {0};
+        if (sv_strtoll(cell_value, tc, &value.integer)) {
+            table_set_value(table, cell, VALUE_TYPE_INT, value);
+        } else if (sv_strtod(cell_value,tc, &value.number)) {
+            table_set_value(table, cell, VALUE_TYPE_DOUBLE, value);
+        } else {
+            table_set_text(table, cell, cell_value);
+        }
+    }
+}
+
+/**
+ * Parses table content from a String_View into the table structure.
+ * Processes each cell in the table and sets up appropriate expressions and references.
+ *
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param content String_View containing the CSV content.
+ */
+void parse_table_from_content(Table *table, Expr_Buffer *eb, Tmp_Cstr *tc, String_View content)
+{
+    table_index_lines(table, content);
+    for (size_t row = 0; row < table->rows; ++row) {
+        String_View line = table->lines[row];
+        const char *const line_start = line.data;
+        for (size_t col = 0; col < table->cols; ++col) {
+            String_View cell_value = sv_trim(sv_chop_by_delim(&line, '|'));
+            Cell_Index cell_index = {
+                .col = col,
+                .row = row,
+            };
+
+            size_t cell = table_cell_at(table, cell_index);
+            parse_cell(table, cell, eb, tc, cell_value, table->file_path, row + 1, line_start);
+        }
+    }
+}
+
+/**
+ * Estimates the size of a table from its content.
+ * Counts the number of rows and maximum number of columns.
+ *
+ * @param content String_View containing the CSV content.
+ * @param out_rows Pointer to store the number of rows.
+ * @param out_cols Pointer to store the number of columns.
+ */
+void estimate_table_size(String_View content, size_t *out_rows, size_t *out_cols) 
+{
+    size_t rows = 0;
+    size_t cols = 0;
+    for(; content.count > 0; ++rows) {
+        String_View line = sv_chop_by_delim(&content, '\n');
+
+        size_t col = 0;
+        for(; line.count > 0; ++col) {
+            sv_trim(sv_chop_by_delim(&line, '|'));
+        }
+
+        if(cols < col) {
+            cols = col;
+        }
+    }
+
+    if(out_rows) *out_rows = rows;
+    if(out_cols) *out_cols = cols;
+}
+
+// Binary cache of a parsed table. The file consists of a header, the arrays of the
+// parsed cells and the pages of the expression buffer. Nothing in the file depends on the address
+// it is loaded at: expressions refer to each other by indices and the texts of the cells
+// are stored as offsets into the input. The pages of expressions are aligned so that
+// they can be used right from the mapped file.
+#define CACHE_MAGIC "EXCLCACH"
+#define CACHE_VERSION 6
+#define CACHE_ALIGNMENT 4096
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t formula_size;       // sizeof(Cell_Expr) of the writer
+    uint32_t expr_size;          // sizeof(Expr) of the writer
+    uint32_t expr_page_capacity; // EXPR_PAGE_CAPACITY of the writer
+    uint64_t input_hash;         // Hash of the input the table was parsed from
+    uint64_t input_size;         // Size of the input the table was parsed from
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t texts_count;
+    uint64_t formulas_count;
+    uint64_t exprs_count;
+    uint64_t words_offset;         // Offset of the words of the cells in the file
+    uint64_t flags_offset;         // Offset of the flags of the cells in the file
+    uint64_t texts_offset;         // Offset of the texts in the file
+    uint64_t formulas_offset;      // Offset of the formulas in the file
+    uint64_t exprs_offset;         // Offset of the first page of expressions in the file
+    uint64_t file_size;
+} Cache_Header;
+
+// A cache file loaded into memory
+typedef struct {
+    char *data;
+    size_t size;
+    bool mapped;
+} Cache;
+
+/**
+ * Hashes the content of an input file with 64-bit FNV-1a.
+ *
+ * @param content The content to hash.
+ * @return The hash of the content.
+ */
+uint64_t input_hash(String_View content)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < content.count; ++i) {
+        hash ^= (unsigned char) content.data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Builds the path of the cache file of an input in the cache directory.
+ * The name of the file is the hash of the input.
+ *
+ * @param cache_dir Path to the cache directory.
+ * @param content Content of the input.
+ * @return Newly allocated path to the cache file.
+ */
+char *cache_path_for(const char *cache_dir, String_View content)
+{
+    size_t size = strlen(cache_dir) + 32;
+    char *path = malloc(size);
+    snprintf(path, size, "%s/%016llx.cache", cache_dir, (unsigned long long) input_hash(content));
+    return path;
+}
+
+/**
+ * Pads a file with zeros up to the alignment.
+ *
+ * @param stream Output file stream.
+ * @param offset Pointer to the current offset in the file.
+ * @param alignment The alignment.
+ */
+void cache_write_padding(FILE *stream, uint64_t *offset, uint64_t alignment)
+{
+    while(*offset % alignment != 0) {
+        fputc(0, stream);
+        *offset += 1;
+    }
+}
+
+/**
+ * Computes the offsets of the arrays of the cells and of the pages of expressions
+ * in the cache file from the size of the table and the number of expressions.
+ * Every array starts at a cache line, the pages at CACHE_ALIGNMENT.
+ *
+ * @param header Pointer to the header with the sizes filled.
+ */
+void cache_layout(Cache_Header *header)
+{
+    uint64_t cells_count = header->rows * header->cols;
+    header->words_offset = (sizeof(*header) + 63) / 64 * 64;
+    header->flags_offset = (header->words_offset + cells_count * sizeof(uint64_t) + 63) / 64 * 64;
+    header->texts_offset = (header->flags_offset + cells_count * sizeof(uint8_t) + 63) / 64 * 64;
+    header->formulas_offset = (header->texts_offset + header->texts_count * sizeof(String_View) + 63) / 64 * 64;
+    header->exprs_offset = (header->formulas_offset + header->formulas_count * sizeof(Cell_Expr) + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+    header->file_size = header->exprs_offset + header->exprs_count * sizeof(Expr);
+}
+
+/**
+ * Saves a freshly parsed table into the cache.
+ * Failure to write the cache is reported but not fatal.
+ *
+ * @param cache_path Path to the cache file.
+ * @param table Pointer to the parsed, not yet evaluated table.
+ * @param eb Pointer to the expression buffer.
+ * @param content Content of the input the table was parsed from.
+ */
+void cache_save(const char *cache_path, const Table *table, const Expr_Buffer *eb, String_View content)
+{
+    FILE *stream = fopen(cache_path, "wb");
+    if(stream == NULL) {
+        fprintf(stderr, "WARNING: could not write cache file %s: %s\n", cache_path, strerror(errno));
+        return;
+    }
+
+    size_t cells_count = table->rows * table->cols;
+    Cache_Header header = {
+        .version = CACHE_VERSION,
+        .formula_size = sizeof(Cell_Expr),
+        .expr_size = sizeof(Expr),
+        .expr_page_capacity = EXPR_PAGE_CAPACITY,
+        .input_hash = input_hash(content),
+        .input_size = content.count,
+        .rows = table->rows,
+        .cols = table->cols,
+        .texts_count = table->texts_count,
+        .formulas_count = table->formulas_count,
+        .exprs_count = eb->count,
+    };
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    cache_layout(&header);
+
+    uint64_t offset = 0;
+    fwrite(&header, sizeof(header), 1, stream);
+    offset += sizeof(header);
+    cache_write_padding(stream, &offset, 64);
+
+    fwrite(table->words, sizeof(*table->words), cells_count, stream);
+    offset += cells_count * sizeof(*table->words);
+    cache_write_padding(stream, &offset, 64);
+
+    fwrite(table->flags, sizeof(*table->flags), cells_count, stream);
+    offset += cells_count * sizeof(*table->flags);
+    cache_write_padding(stream, &offset, 64);
+
+    for(size_t i = 0; i < table->texts_count; ++i) {
+        String_View text = table->texts[i];
+        // The pointer of the text is stored as an offset into the input,
+        // the empty text does not point into it
+        text.data = (const char *) (uintptr_t) (i == 0 ? 0 : text.data - content.data);
+        fwrite(&text, sizeof(text), 1, stream);
+    }
+    offset += table->texts_count * sizeof(*table->texts);
+    cache_write_padding(stream, &offset, 64);
+
+    // A sheet without formulas has no array of them to write
+    if(table->formulas_count > 0) {
+        fwrite(table->formulas, sizeof(*table->formulas), table->formulas_count, stream);
+    }
+    offset += table->formulas_count * sizeof(*table->formulas);
+    cache_write_padding(stream, &offset, CACHE_ALIGNMENT);
+
+    for(size_t i = 0; i < eb->pages_count; ++i) {
+        size_t page_count = eb->count - i * EXPR_PAGE_CAPACITY;
+        if(page_count > EXPR_PAGE_CAPACITY) page_count = EXPR_PAGE_CAPACITY;
+        fwrite(eb->pages[i], sizeof(Expr), page_count, stream);
+    }
+
+    if(ferror(stream)) {
+        fprintf(stderr, "WARNING: could not write cache file %s: %s\n", cache_path, strerror(errno));
+    }
+    fclose(stream);
+}
+
+/**
+ * Releases the memory of a loaded cache.
+ * Must be called after the expression buffer borrowing its pages is freed.
+ *
+ * @param cache Pointer to the cache.
+ */
+void cache_free(Cache *cache)
+{
+    if(cache->data == NULL) return;
+#ifndef _WIN32
+    if(cache->mapped) {
+        munmap(cache->data, cache->size);
+    } else {
+        free(cache->data);
+    }
+#else
+    free(cache->data);
+#endif
+    memset(cache, 0, sizeof(*cache));
+}
+
+/**
+ * Loads a table parsed by a previous run from the cache.
+ * The full pages of expressions are used right from the mapped file,
+ * the arrays of the cells are copied since evaluation modifies them.
+ *
+ * @param cache Pointer to the cache to keep the file in.
+ * @param cache_path Path to the cache file.
+ * @param table Pointer to the table structure to fill.
+ * @param eb Pointer to the empty expression buffer to fill.
+ * @param content Content of the input.
+ * @return true if the cache matches the input and was loaded, false otherwise.
+ */
+bool cache_load(Cache *cache, const char *cache_path, Table *table, Expr_Buffer *eb, String_View content)
+{
+    assert(eb->count == 0);
+
+#ifndef _WIN32
+    FILE *f = fopen(cache_path, "rb");
+    if(f == NULL) return false;
+    if(fseek(f, 0, SEEK_END) < 0) { fclose(f); return false; }
+    long size = ftell(f);
+    if(size < (long) sizeof(Cache_Header)) { fclose(f); return false; }
+
+    void *data = mmap(NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+    fclose(f);
+    if(data == MAP_FAILED) return false;
+
+    cache->data = data;
+    cache->size = (size_t) size;
+    cache->mapped = true;
+#else
+    cache->data = read_csv(cache_path, &cache->size);
+    if(cache->data == NULL) return false;
+    cache->mapped = false;
+#endif
+
+    Cache_Header header = {0};
+    if(cache->size >= sizeof(header)) memcpy(&header, cache->data, sizeof(header));
+
+    if(cache->size < sizeof(header) ||
+       memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != CACHE_VERSION ||
+       header.formula_size != sizeof(Cell_Expr) ||
+       header.expr_size != sizeof(Expr) ||
+       header.expr_page_capacity != EXPR_PAGE_CAPACITY ||
+       header.input_size != content.count ||
+       header.input_hash != input_hash(content) ||
+       header.file_size != cache->size ||
+       header.exprs_offset % CACHE_ALIGNMENT != 0) {
+        fprintf(stderr, "WARNING: cache file %s does not match the input, ignoring it\n", cache_path);
+        cache_free(cache);
+        return false;
+    }
+
+    Cache_Header layout = header;
+    cache_layout(&layout);
+    if(memcmp(&layout, &header, sizeof(header)) != 0) {
+        fprintf(stderr, "WARNING: cache file %s does not match the input, ignoring it\n", cache_path);
+        cache_free(cache);
+        return false;
+    }
+
+    table->rows = header.rows;
+    table->cols = header.cols;
+    size_t cells_count = table->rows * table->cols;
+    table_alloc(table);
+    table_index_lines(table, content);
+    memcpy(table->words, cache->data + header.words_offset, sizeof(*table->words) * cells_count);
+    memcpy(table->flags, cache->data + header.flags_offset, sizeof(*table->flags) * cells_count);
+
+    table->texts_capacity = header.texts_count;
+    table->texts_count = header.texts_count;
+    table->texts = realloc(table->texts, sizeof(*table->texts) * table->texts_capacity);
+    memcpy(table->texts, cache->data + header.texts_offset, sizeof(*table->texts) * table->texts_count);
+    table->texts[0] = SV("");
+    for(size_t i = 1; i < table->texts_count; ++i) {
+        table->texts[i].data = content.data + (uintptr_t) table->texts[i].data;
+    }
+
+    table->formulas_capacity = header.formulas_count + 1;
+    table->formulas_count = header.formulas_count;
+    table->formulas = malloc(sizeof(*table->formulas) * table->formulas_capacity);
+    memcpy(table->formulas, cache->data + header.formulas_offset, sizeof(*table->formulas) * table->formulas_count);
+
+    size_t full_pages = header.exprs_count / EXPR_PAGE_CAPACITY;
+    size_t pages_count = (header.exprs_count + EXPR_PAGE_CAPACITY - 1) / EXPR_PAGE_CAPACITY;
+    eb->pages_capacity = pages_count < 16 ? 16 : pages_count;
+    eb->pages = malloc(sizeof(*eb->pages) * eb->pages_capacity);
+    for(size_t i = 0; i < full_pages; ++i) {
+        eb->pages[i] = (Expr *) (cache->data + header.exprs_offset) + i * EXPR_PAGE_CAPACITY;
+    }
+    eb->pages_borrowed = full_pages;
+    eb->pages_count = full_pages;
+
+    if(pages_count > full_pages) {
+        // The last page is not full, copy it so that new expressions can be appended to it
+        Expr *page = expr_page_alloc(eb->huge_pages);
+        memcpy(page, (Expr *) (cache->data + header.exprs_offset) + full_pages * EXPR_PAGE_CAPACITY,
+            sizeof(Expr) * (header.exprs_count - full_pages * EXPR_PAGE_CAPACITY));
+        eb->pages[eb->pages_count++] = page;
+    }
+    eb->count = header.exprs_count;
+
+    return true;
+}
+
+/**
+ * Displaces a cell index by an offset.
+ * Fails if the displaced cell lies outside of the table.
+ *
+ * @param table Pointer to the table structure.
+ * @param index The starting cell index.
+ * @param offset The displacement to apply.
+ * @param out Pointer to store the displaced cell index.
+ * @return true if the displaced cell is inside of the table, false otherwise.
+ */
+bool table_offset_index(const Table *table, Cell_Index index, Cell_Offset offset, Cell_Index *out)
+{
+    ptrdiff_t row = (ptrdiff_t) index.row + offset.row;
+    ptrdiff_t col = (ptrdiff_t) index.col + offset.col;
+
+    if(row < 0 || col < 0 || (size_t) row >= table->rows || (size_t) col >= table->cols) {
+        return false;
+    }
+
+    if(out) {
+        out->row = (size_t) row;
+        out->col = (size_t) col;
+    }
+    return true;
+}
+
+// Kinds of operands of the formula bytecode
+typedef enum {
+    OPERAND_REG = 0, // Register of the executing program
+    OPERAND_CELL,    // Cell reference displaced by the evaluating cell's offset
+    OPERAND_CONST,   // Numeric constant
+    COUNT_OPERAND_KINDS,
+} Operand_Kind;
+
+// Numeric constant of the bytecode in both of its representations
+typedef struct {
+    double number;   // Value used by the floating point execution
+    int64_t integer; // Value used by the integer execution of integral programs
+} Operand_Const;
+
+// Payload of an operand. Its kind is encoded in the instruction kind.
+typedef union {
+    size_t reg;
+    Cell_Index cell;
+    Operand_Const constant;
+} Operand_As;
+
+typedef struct {
+    Operand_Kind kind;
+    Operand_As as;
+} Operand;
+
+// When both of the operands are errors, the one on the left propagates like in Excel. The
+// hardware returns the NaN of the first operand then, but the compiler is free to swap the
+// operands of the commutative operations, so the left one is checked first.
+double vm_add(double lhs, double rhs) { return isnan(lhs) ? lhs : lhs + rhs; }
+double vm_sub(double lhs, double rhs) { return isnan(lhs) ? lhs : lhs - rhs; }
+double vm_mul(double lhs, double rhs) { return isnan(lhs) ? lhs : lhs * rhs; }
+
+// Dividing a number by zero is a #DIV/0! error, an error divided by anything stays itself
+double vm_div(double lhs, double rhs)
+{
+    if(isnan(lhs)) return lhs;
+    if(rhs == 0.0) return error_value(ERROR_KIND_DIV0);
+    return lhs / rhs;
+}
+
+// The exponent is truncated toward zero. Exponents out of the range of int64_t
+// are left to pow, which agrees with the repeated squaring on them. NaNs, errors
+// included, are propagated first, since x^0 and 1^NaN would give one. Zero to a
+// negative power divides by zero, which is a #DIV/0! error.
+double vm_pow(double lhs, double rhs)
+{
+    if(isnan(lhs)) return lhs;
+    if(isnan(rhs)) return rhs;
+    if(lhs == 0.0 && rhs <= -1.0) return error_value(ERROR_KIND_DIV0);
+    if(rhs > -9223372036854775808.0 && rhs < 9223372036854775808.0) {
+        return bin_pow(lhs, (int64_t) rhs);
+    }
+    return pow(lhs, trunc(rhs));
+}
+
+// Both operands are truncated toward zero. Adding 0.0 turns the -0.0 of fmod
+// into 0.0, which is what the integer remainder yields. NaNs, errors included, are
+// propagated first, and the remainder of a number by zero is a #DIV/0! error.
+double vm_mod(double lhs, double rhs)
+{
+    if(isnan(lhs)) return lhs;
+    if(isnan(rhs)) return rhs;
+    if(trunc(rhs) == 0.0) return error_value(ERROR_KIND_DIV0);
+    return fmod(trunc(lhs), trunc(rhs)) + 0.0;
+}
+
+// Integer implementations of the binary operations. They fail on overflow and
+// whenever the result is not an integer, the caller then falls back to doubles.
+bool vm_add_int(int64_t lhs, int64_t rhs, int64_t *out)
+{
+#ifdef __GNUC__
+    return !__builtin_add_overflow(lhs, rhs, out);
+#else
+    if((rhs > 0 && lhs > INT64_MAX - rhs) || (rhs < 0 && lhs < INT64_MIN - rhs)) return false;
+    *out = lhs + rhs;
+    return true;
+#endif
+}
+
+bool vm_sub_int(int64_t lhs, int64_t rhs, int64_t *out)
+{
+#ifdef __GNUC__
+    return !__builtin_sub_overflow(lhs, rhs, out);
+#else
+    if((rhs < 0 && lhs > INT64_MAX + rhs) || (rhs > 0 && lhs < INT64_MIN + rhs)) return false;
+    *out = lhs - rhs;
+    return true;
+#endif
+}
+
+bool vm_mul_int(int64_t lhs, int64_t rhs, int64_t *out)
+{
+#ifdef __GNUC__
+    return !__builtin_mul_overflow(lhs, rhs, out);
+#else
+    if(lhs > 0 ? (rhs > 0 ? lhs > INT64_MAX / rhs : rhs < INT64_MIN / lhs)
+               : (rhs > 0 ? lhs < INT64_MIN / rhs : (lhs != 0 && rhs < INT64_MAX / lhs))) {
+        return false;
+    }
+    *out = lhs * rhs;
+    return true;
+#endif
+}
+
+bool vm_div_int(int64_t lhs, int64_t rhs, int64_t *out)
+{
+    if(rhs == 0 || (lhs == INT64_MIN && rhs == -1) || lhs % rhs != 0) return false;
+    *out = lhs / rhs;
+    return true;
+}
+
+bool vm_pow_int(int64_t lhs, int64_t rhs, int64_t *out)
+{
+    if(rhs < 0) return false;
+
+    int64_t result = 1;
+    while(rhs > 0) {
+        if((rhs & 1) && !vm_mul_int(result, lhs, &result)) return false;
+        rhs >>= 1;
+        if(rhs > 0 && !vm_mul_int(lhs, lhs, &lhs)) return false;
+    }
+
+    *out = result;
+    return true;
+}
+
+bool vm_mod_int(int64_t lhs, int64_t rhs, int64_t *out)
+{
+    if(rhs == 0) return false;
+    *out = rhs == -1 ? 0 : lhs % rhs;
+    return true;
+}
+
+bool vm_neg_int(int64_t param, int64_t *out)
+{
+    if(param == INT64_MIN) return false;
+    *out = -param;
+    return true;
+}
+
+// Binary operations of the virtual machine: instruction name, binary operation kind,
+// floating point implementation, integer implementation
+#define VM_BOPS(X)                               \
+    X(ADD, BOP_KIND_PLUS,  vm_add, vm_add_int)   \
+    X(SUB, BOP_KIND_MINUS, vm_sub, vm_sub_int)   \
+    X(MUL, BOP_KIND_MULT,  vm_mul, vm_mul_int)   \
+    X(DIV, BOP_KIND_DIV,   vm_div, vm_div_int)   \
+    X(POW, BOP_KIND_POW,   vm_pow, vm_pow_int)   \
+    X(MOD, BOP_KIND_MOD,   vm_mod, vm_mod_int)
+
+// Operand combinations every binary operation is specialised for.
+// A cell on the left of a register is loaded into a register first, so that
+// the cells are still evaluated in the order they appear in the formula, and
+// operations over two constants are folded during the compilation.
+#define VM_SHAPES(X, NAME, KIND, FN, INT_FN) \
+    X(NAME, KIND, FN, INT_FN, REG,   REG)    \
+    X(NAME, KIND, FN, INT_FN, REG,   CELL)   \
+    X(NAME, KIND, FN, INT_FN, REG,   CONST)  \
+    X(NAME, KIND, FN, INT_FN, CELL,  CELL)   \
+    X(NAME, KIND, FN, INT_FN, CELL,  CONST)  \
+    X(NAME, KIND, FN, INT_FN, CONST, REG)    \
+    X(NAME, KIND, FN, INT_FN, CONST, CELL)
+
+#define VM_BOP_SHAPES(X) VM_SHAPES(X, ADD, BOP_KIND_PLUS,  vm_add, vm_add_int) \
+                         VM_SHAPES(X, SUB, BOP_KIND_MINUS, vm_sub, vm_sub_int) \
+                         VM_SHAPES(X, MUL, BOP_KIND_MULT,  vm_mul, vm_mul_int) \
+                         VM_SHAPES(X, DIV, BOP_KIND_DIV,   vm_div, vm_div_int) \
+                         VM_SHAPES(X, POW, BOP_KIND_POW,   vm_pow, vm_pow_int) \
+                         VM_SHAPES(X, MOD, BOP_KIND_MOD,   vm_mod, vm_mod_int)
+
+// Kinds of instructions of the formula bytecode.
+// A formula is compiled into a register-based program in which every binary
+// operation is a superinstruction fused with the loads of its operands,
+// e.g. INST_ADD_CELL_CELL or INST_MUL_CELL_CONST.
+typedef enum {
+    INST_LOAD_CONST = 0, // dst = constant
+    INST_LOAD_CELL,      // dst = cell
+    INST_NEG_REG,        // dst = -register
+    INST_NEG_CELL,       // dst = -cell
+#define X(name, kind, fn, int_fn, a, b) INST_##name##_##a##_##b,
+    VM_BOP_SHAPES(X)
+#undef X
+    INST_RET,            // Return the value of the register
+    COUNT_INST_KINDS,
+} Inst_Kind;
+
+static_assert(COUNT_BOP_KINDS == 6, 
+    "The amount of binary operators has changed. Please adjust VM_BOPS accordingly.\n");
+
+// Instruction kinds of the binary operations by their operand kinds
+static const Inst_Kind bop_inst_kinds[COUNT_BOP_KINDS][COUNT_OPERAND_KINDS][COUNT_OPERAND_KINDS] = {
+#define X(name, kind, fn, int_fn, a, b) [kind][OPERAND_##a][OPERAND_##b] = INST_##name##_##a##_##b,
+    VM_BOP_SHAPES(X)
+#undef X
+};
+
+// Kinds of the operands of every instruction, COUNT_OPERAND_KINDS if the instruction has no such operand
+static const Operand_Kind inst_operand_kinds[COUNT_INST_KINDS][2] = {
+    [INST_LOAD_CONST] = { OPERAND_CONST, COUNT_OPERAND_KINDS },
+    [INST_LOAD_CELL]  = { OPERAND_CELL,  COUNT_OPERAND_KINDS },
+    [INST_NEG_REG]    = { OPERAND_REG,   COUNT_OPERAND_KINDS },
+    [INST_NEG_CELL]   = { OPERAND_CELL,  COUNT_OPERAND_KINDS },
+#define X(name, kind, fn, int_fn, lhs_kind, rhs_kind) [INST_##name##_##lhs_kind##_##rhs_kind] = { OPERAND_##lhs_kind, OPERAND_##rhs_kind },
+    VM_BOP_SHAPES(X)
+#undef X
+    [INST_RET]        = { OPERAND_REG,   COUNT_OPERAND_KINDS },
+};
+
+// A single bytecode instruction
+typedef struct {
+    Inst_Kind kind;
+    size_t dst;      // Destination register
+    Operand_As a;    // Left-hand side or the only operand
+    Operand_As b;    // Right-hand side operand
+} Inst;
+
+// Register of the virtual machine, its representation depends on the execution
+typedef union {
+    double number;
+    int64_t integer;
+} Vm_Value;
+
+// A compiled formula
+typedef struct {
+    size_t start;   // Index of the first instruction
+    size_t regs;    // Number of registers used by the program
+    size_t cells;   // Number of cell operands of the program
+    Cell_Index min; // Corners of the box bounding the cell operands, meaningful only if cells > 0
+    Cell_Index max;
+    size_t native;  // Offset of the native code compiled by the JIT plus one, 0 if there is none
+    size_t native_int; // Same for the native code of the integer arithmetic of an integral program
+    bool integral;  // The formula is integral and is tried with integer arithmetic first
+} Program;
+
+// Native code emitted by the JIT
+typedef struct {
+    unsigned char *items; // Code being emitted
+    size_t count;
+    size_t capacity;
+
+    unsigned char *code;  // Executable mapping of the emitted code
+    size_t code_size;
+} Jit;
+
+// A cell on the work stack of the evaluation
+typedef struct {
+    Cell_Index cell;
+    bool started;      // The dependencies of the formula of the cell are being evaluated
+    size_t pc;         // Instruction of the formula whose cell operands are checked next
+    size_t operand;    // Operand of the instruction checked next
+} Eval_Frame;
+
+// Compiled formulas of the whole table and the state of the virtual machine running them
+typedef struct {
+    Inst *items;      // Instructions of all the compiled formulas
+    size_t count;
+    size_t capacity;
+
+    Program *programs; // Compiled formulas
+    size_t programs_count;
+    size_t programs_capacity;
+
+    size_t *program_by_expr; // Program index plus one for every formula root, 0 if not compiled yet
+    size_t program_by_expr_capacity;
+
+    Vm_Value *stack;  // Register frames of the executions
+    size_t stack_top;
+    size_t stack_capacity;
+
+    Eval_Frame *evals; // Work stack of the cells being evaluated, see table_eval_cell
+    size_t evals_count;
+    size_t evals_capacity;
+
+    Jit jit;
+} Bytecode;
+
+/**
+ * Appends an instruction to the bytecode.
+ *
+ * @param bc Pointer to the bytecode.
+ * @param inst The instruction to append.
+ */
+void bytecode_push_inst(Bytecode *bc, Inst inst)
+{
+    if(bc->count >= bc->capacity) {
+        bc->capacity = bc->capacity == 0 ? 256 : bc->capacity * 2;
+        bc->items = realloc(bc->items, sizeof(*bc->items) * bc->capacity);
+    }
+
+    bc->items[bc->count++] = inst;
+}
+
+/**
+ * Makes sure an operand lives in a register, emitting a load if it does not.
+ *
+ * @param bc Pointer to the bytecode.
+ * @param operand The operand.
+ * @param reg The register to load the operand into.
+ * @return The register operand.
+ */
+Operand bytecode_load_operand(Bytecode *bc, Operand operand, size_t reg)
+{
+    Inst inst = {
+        .dst = reg,
+        .a = operand.as,
+    };
+
+    switch(operand.kind) {
+        case OPERAND_REG: return operand;
+        case OPERAND_CELL: inst.kind = INST_LOAD_CELL; break;
+        case OPERAND_CONST: inst.kind = INST_LOAD_CONST; break;
+        case COUNT_OPERAND_KINDS:
+        default:
+            UNREACHABLE("Unknown operand kind");
+    }
+
+    bytecode_push_inst(bc, inst);
+    return (Operand) { .kind = OPERAND_REG, .as.reg = reg };
+}
+
+/**
+ * Compiles an expression tree into register instructions.
+ * Leaves are not loaded but returned as operands to be fused into the instruction using them.
+ * Registers are allocated as a stack: the expression may use `reg` and the registers above it.
+ *
+ * @param bc Pointer to the bytecode.
+ * @param eb Pointer to the expression buffer.
+ * @param expr_index Index of the expression to compile.
+ * @param reg The first free register.
+ * @param regs Pointer to the number of registers used so far.
+ * @return The operand holding the value of the expression.
+ */
+Operand bytecode_compile_expr(Bytecode *bc, const Expr_Buffer *eb, Expr_Index expr_index, size_t reg, size_t *regs)
+{
+    Expr *expr = expr_buffer_at(eb, expr_index);
+
+    switch(expr->kind) {
+        case EXPR_KIND_NUMBER: {
+            Operand_Const constant = {0};
+            if(expr->type == VALUE_TYPE_INT) {
+                constant.integer = expr->as.integer;
+                constant.number = (double) expr->as.integer;
+            } else {
+                constant.number = expr->as.number;
+            }
+            return (Operand) { .kind = OPERAND_CONST, .as.constant = constant };
+        }
+        case EXPR_KIND_CELL:
+            return (Operand) { .kind = OPERAND_CELL, .as.cell = expr->as.cell };
+        case EXPR_KIND_BOP: {
+            Expr_Bop bop = expr->as.bop;
+
+            Operand lhs = bytecode_compile_expr(bc, eb, bop.lhs, reg, regs);
+            Operand rhs = bytecode_compile_expr(bc, eb, bop.rhs, lhs.kind == OPERAND_REG ? reg + 1 : reg, regs);
+
+            if(lhs.kind == OPERAND_CONST && rhs.kind == OPERAND_CONST) {
+                Operand_Const constant = {0};
+                bool folded = true;
+                switch(bop.kind) {
+#define X(name, kind, fn, int_fn)                                                                   \
+                    case kind:                                                                      \
+                        constant.number = fn(lhs.as.constant.number, rhs.as.constant.number);       \
+                        if(expr->type == VALUE_TYPE_INT) {                                          \
+                            folded = int_fn(lhs.as.constant.integer, rhs.as.constant.integer, &constant.integer); \
+                        }                                                                           \
+                        break;
+                    VM_BOPS(X)
+#undef X
+                    case COUNT_BOP_KINDS:
+                    default: {
+                        UNREACHABLE("Unknown binary operator kind");
+                    }
+                }
+                // The integer operation failed, leave it to the execution to fall back to doubles
+                if(folded) return (Operand) { .kind = OPERAND_CONST, .as.constant = constant };
+                lhs = bytecode_load_operand(bc, lhs, reg);
+            }
+
+            if(lhs.kind == OPERAND_CELL && rhs.kind == OPERAND_REG) {
+                // The right-hand side has already been computed into `reg`, keep the left one above it
+                lhs = bytecode_load_operand(bc, lhs, reg + 1);
+            }
+
+            assert(bop.kind < COUNT_BOP_KINDS);
+            Inst inst = {
+                .kind = bop_inst_kinds[bop.kind][lhs.kind][rhs.kind],
+                .dst = reg,
+                .a = lhs.as,
+                .b = rhs.as,
+            };
+            if(*regs < reg + 2) *regs = reg + 2;
+            bytecode_push_inst(bc, inst);
+            return (Operand) { .kind = OPERAND_REG, .as.reg = reg };
+        } break;
+        case EXPR_KIND_UOP: {
+            Expr_Uop uop = expr->as.uop;
+            Operand param = bytecode_compile_expr(bc, eb, uop.param, reg, regs);
+
+            switch(uop.kind) {
+                case UOP_KIND_MINUS: {
+                    Inst inst = {
+                        .dst = reg,
+                        .a = param.as,
+                    };
+                    if(param.kind == OPERAND_CONST) {
+                        Operand_Const constant = { .number = -param.as.constant.number };
+                        if(expr->type != VALUE_TYPE_INT || vm_neg_int(param.as.constant.integer, &constant.integer)) {
+                            return (Operand) { .kind = OPERAND_CONST, .as.constant = constant };
+                        }
+                        // The integer negation overflows, leave it to the execution to fall back to doubles
+                        param = bytecode_load_operand(bc, param, reg);
+                        inst.a = param.as;
+                    }
+
+                    switch(param.kind) {
+                        case OPERAND_REG: inst.kind = INST_NEG_REG; break;
+                        case OPERAND_CELL: inst.kind = INST_NEG_CELL; break;
+                        case OPERAND_CONST:
+                        case COUNT_OPERAND_KINDS:
+                        default:
+                            UNREACHABLE("Unknown operand kind");
+                    }
+                    if(*regs < reg + 1) *regs = reg + 1;
+                    bytecode_push_inst(bc, inst);
+                    return (Operand) { .kind = OPERAND_REG, .as.reg = reg };
+                }
+                default: {
+                    UNREACHABLE("Unknown unary operator kind");
+                }
+            }
+        } break;
+        default: {
+            UNREACHABLE("Unknown expression kind");
+        }
+    }
+}
+
+/**
+ * Returns the program compiled from a formula root.
+ * Every formula is compiled only once, on the first request.
+ *
+ * @param bc Pointer to the bytecode.
+ * @param eb Pointer to the expression buffer.
+ * @param root Index of the formula root.
+ * @return Pointer to the compiled program.
+ */
+const Program *bytecode_program(Bytecode *bc, const Expr_Buffer *eb, Expr_Index root)
+{
+    if(root >= bc->program_by_expr_capacity) {
+        size_t capacity = bc->program_by_expr_capacity == 0 ? 256 : bc->program_by_expr_capacity;
+        while(capacity <= root) capacity *= 2;
+        bc->program_by_expr = realloc(bc->program_by_expr, sizeof(*bc->program_by_expr) * capacity);
+        memset(bc->program_by_expr + bc->program_by_expr_capacity, 0, 
+            sizeof(*bc->program_by_expr) * (capacity - bc->program_by_expr_capacity));
+        bc->program_by_expr_capacity = capacity;
+    }
+
+    if(bc->program_by_expr[root] == 0) {
+        Program program = {
+            .start = bc->count,
+            .regs = 1,
+            .integral = expr_buffer_at(eb, root)->type == VALUE_TYPE_INT,
+        };
+        Operand result = bytecode_compile_expr(bc, eb, root, 0, &program.regs);
+        result = bytecode_load_operand(bc, result, 0);
+        bytecode_push_inst(bc, (Inst) { .kind = INST_RET, .a = result.as });
+
+        for(size_t pc = program.start; pc < bc->count; ++pc) {
+            for(size_t i = 0; i < 2; ++i) {
+                if(inst_operand_kinds[bc->items[pc].kind][i] != OPERAND_CELL) continue;
+
+                Cell_Index ref = i == 0 ? bc->items[pc].a.cell : bc->items[pc].b.cell;
+                if(program.cells == 0) program.min = program.max = ref;
+                if(ref.row < program.min.row) program.min.row = ref.row;
+                if(ref.col < program.min.col) program.min.col = ref.col;
+                if(ref.row > program.max.row) program.max.row = ref.row;
+                if(ref.col > program.max.col) program.max.col = ref.col;
+                program.cells += 1;
+            }
+        }
+
+        if(bc->programs_count >= bc->programs_capacity) {
+            bc->programs_capacity = bc->programs_capacity == 0 ? 64 : bc->programs_capacity * 2;
+            bc->programs = realloc(bc->programs, sizeof(*bc->programs) * bc->programs_capacity);
+        }
+        bc->programs[bc->programs_count++] = program;
+        bc->program_by_expr[root] = bc->programs_count;
+    }
+
+    return &bc->programs[bc->program_by_expr[root] - 1];
+}
+
+/**
+ * Releases all the memory owned by the bytecode.
+ *
+ * @param bc Pointer to the bytecode.
+ */
+void bytecode_free(Bytecode *bc)
+{
+    free(bc->items);
+    free(bc->programs);
+    free(bc->program_by_expr);
+    free(bc->stack);
+    free(bc->evals);
+    free(bc->jit.items);
+#ifndef _WIN32
+    if(bc->jit.code) munmap(bc->jit.code, bc->jit.code_size);
+#endif
+    memset(bc, 0, sizeof(*bc));
+}
+
+// The JIT emits x86-64 SSE2 code following the System V calling convention.
+// Other targets keep running the formulas on the interpreter.
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(JIT_DISABLE)
+#define JIT_SUPPORTED
+#endif
+
+// Signature of a formula compiled by the JIT: takes the words and the flags of the cells
+// of the table and the row-major displacement of the evaluating cell's formula template,
+// loads the cell operands itself and returns the result. The caller makes sure that every
+// cell operand lies inside of the table, see table_eval_expr_number.
+typedef double (*Jit_Fn)(const uint64_t *words, const uint8_t *flags, ptrdiff_t origin);
+
+// Signature of the integer arithmetic of an integral formula compiled by the JIT: stores the
+// result and returns true, or returns false as table_eval_expr_int does, see Jit_Fn.
+typedef bool (*Jit_Int_Fn)(const uint64_t *words, const uint8_t *flags, ptrdiff_t origin, int64_t *out);
+
+#ifdef JIT_SUPPORTED
+
+/**
+ * Appends raw bytes to the code being emitted.
+ *
+ * @param jit Pointer to the JIT.
+ * @param bytes Bytes to append.
+ * @param count Number of bytes.
+ */
+void jit_emit_bytes(Jit *jit, const unsigned char *bytes, size_t count)
+{
+    if(jit->count + count > jit->capacity) {
+        if(jit->capacity == 0) jit->capacity = 4096;
+        while(jit->count + count > jit->capacity) jit->capacity *= 2;
+        jit->items = realloc(jit->items, jit->capacity);
+    }
+
+    memcpy(jit->items + jit->count, bytes, count);
+    jit->count += count;
+}
+
+#define JIT_EMIT(jit, ...)                                              \
+    do {                                                                \
+        const unsigned char jit_bytes_[] = { __VA_ARGS__ };             \
+        jit_emit_bytes((jit), jit_bytes_, sizeof(jit_bytes_));          \
+    } while(0)
+
+/**
+ * Appends a little-endian 32-bit immediate to the code being emitted.
+ *
+ * @param jit Pointer to the JIT.
+ * @param value The immediate.
+ */
+void jit_emit_u32(Jit *jit, uint32_t value)
+{
+    JIT_EMIT(jit, value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF);
+}
+
+/**
+ * Appends a little-endian 64-bit immediate to the code being emitted.
+ *
+ * @param jit Pointer to the JIT.
+ * @param value The immediate.
+ */
+void jit_emit_u64(Jit *jit, uint64_t value)
+{
+    jit_emit_u32(jit, (uint32_t) value);
+    jit_emit_u32(jit, (uint32_t) (value >> 32));
+}
+
+/**
+ * Emits the load of an operand into xmm0 or xmm1.
+ * Registers live in the stack frame. Cell operands are read from the words pointed by rbx
+ * and the flags pointed by r12, both already displaced by the origin of the formula template:
+ * integers are converted to doubles and texts load a #VALUE! error, as in table_load_number.
+ *
+ * @param jit Pointer to the JIT.
+ * @param xmm Number of the SSE register (0 or 1).
+ * @param kind Kind of the operand.
+ * @param operand The operand.
+ * @param cols Number of columns of the table.
+ */
+void jit_emit_load(Jit *jit, unsigned char xmm, Operand_Kind kind, Operand_As operand, size_t cols)
+{
+    assert(xmm < 2);
+    switch(kind) {
+        case OPERAND_REG:
+            // movsd xmm, [rsp + disp32]
+            JIT_EMIT(jit, 0xF2, 0x0F, 0x10, 0x84 | (xmm << 3), 0x24);
+            jit_emit_u32(jit, (uint32_t) (operand.reg * sizeof(double)));
+            break;
+        case OPERAND_CELL: {
+            size_t index = operand.cell.row * cols + operand.cell.col;
+            uint64_t error_bits = 0;
+            double error = error_value(ERROR_KIND_VALUE);
+            memcpy(&error_bits, &error, sizeof(error_bits));
+
+            // mov rax, [rbx + disp32]
+            JIT_EMIT(jit, 0x48, 0x8B, 0x83);
+            jit_emit_u32(jit, (uint32_t) (index * sizeof(uint64_t)));
+            // test byte [r12 + disp32], CELL_FLAG_INT; jnz int
+            JIT_EMIT(jit, 0x41, 0xF6, 0x84, 0x24);
+            jit_emit_u32(jit, (uint32_t) index);
+            JIT_EMIT(jit, CELL_FLAG_INT, 0x75, 0x20);
+            // mov rcx, rax; shr rcx, 50; cmp ecx, CELL_TAG_SPACE >> 50; jne double
+            JIT_EMIT(jit, 0x48, 0x89, 0xC1, 0x48, 0xC1, 0xE9, 50, 0x81, 0xF9);
+            jit_emit_u32(jit, (uint32_t) (CELL_TAG_SPACE >> 50));
+            JIT_EMIT(jit, 0x75, 0x0A);
+            // mov rax, #VALUE!
+            JIT_EMIT(jit, 0x48, 0xB8);
+            jit_emit_u64(jit, error_bits);
+            // double: movq xmm, rax; jmp done
+            JIT_EMIT(jit, 0x66, 0x48, 0x0F, 0x6E, 0xC0 | (xmm << 3), 0xEB, 0x05);
+            // int: cvtsi2sd xmm, rax
+            JIT_EMIT(jit, 0xF2, 0x48, 0x0F, 0x2A, 0xC0 | (xmm << 3));
+            // done:
+        } break;
+        case OPERAND_CONST: {
+            uint64_t bits = 0;
+            memcpy(&bits, &operand.constant.number, sizeof(bits));
+            // mov rax, imm64; movq xmm, rax
+            JIT_EMIT(jit, 0x48, 0xB8);
+            jit_emit_u64(jit, bits);
+            JIT_EMIT(jit, 0x66, 0x48, 0x0F, 0x6E, 0xC0 | (xmm << 3));
+        } break;
+        case COUNT_OPERAND_KINDS:
+        default:
+            UNREACHABLE("Unknown operand kind");
+    }
+}
+
+/**
+ * Emits a call to a helper taking its arguments in xmm0 and xmm1 and returning the result in xmm0.
+ *
+ * @param jit Pointer to the JIT.
+ * @param fn The helper.
+ */
+void jit_emit_call(Jit *jit, double (*fn)(double, double))
+{
+    uint64_t address = (uint64_t) (uintptr_t) fn;
+    // mov rax, imm64; call rax
+    JIT_EMIT(jit, 0x48, 0xB8);
+    jit_emit_u64(jit, address);
+    JIT_EMIT(jit, 0xFF, 0xD0);
+}
+
+/**
+ * Emits a conditional jump to an already emitted target.
+ *
+ * @param jit Pointer to the JIT.
+ * @param condition Second opcode byte of the jump (0x80 jo, 0x84 jz).
+ * @param target Offset of the target in the code being emitted.
+ */
+void jit_emit_jump(Jit *jit, unsigned char condition, size_t target)
+{
+    // jcc rel32, relative to the end of the instruction
+    JIT_EMIT(jit, 0x0F, condition);
+    jit_emit_u32(jit, (uint32_t) (int32_t) ((ptrdiff_t) target - (ptrdiff_t) (jit->count + 4)));
+}
+
+/**
+ * Emits the load of an integer operand into rax or rcx.
+ * Cell operands that do not hold an integer jump to the failure of the program,
+ * as in table_load_int. See jit_emit_load for the layout of the operands.
+ *
+ * @param jit Pointer to the JIT.
+ * @param reg Number of the general purpose register (0 rax, 1 rcx).
+ * @param kind Kind of the operand.
+ * @param operand The operand.
+ * @param cols Number of columns of the table.
+ * @param fail Offset of the failure of the program.
+ */
+void jit_emit_load_int(Jit *jit, unsigned char reg, Operand_Kind kind, Operand_As operand, size_t cols, size_t fail)
+{
+    assert(reg < 2);
+    switch(kind) {
+        case OPERAND_REG:
+            // mov reg, [rsp + disp32]
+            JIT_EMIT(jit, 0x48, 0x8B, 0x84 | (reg << 3), 0x24);
+            jit_emit_u32(jit, (uint32_t) (operand.reg * sizeof(int64_t)));
+            break;
+        case OPERAND_CELL: {
+            size_t index = operand.cell.row * cols + operand.cell.col;
+            // test byte [r12 + disp32], CELL_FLAG_INT; jz fail
+            JIT_EMIT(jit, 0x41, 0xF6, 0x84, 0x24);
+            jit_emit_u32(jit, (uint32_t) index);
+            JIT_EMIT(jit, CELL_FLAG_INT);
+            jit_emit_jump(jit, 0x84, fail);
+            // mov reg, [rbx + disp32]
+            JIT_EMIT(jit, 0x48, 0x8B, 0x83 | (reg << 3));
+            jit_emit_u32(jit, (uint32_t) (index * sizeof(uint64_t)));
+        } break;
+        case OPERAND_CONST:
+            // mov reg, imm64
+            JIT_EMIT(jit, 0x48, 0xB8 | reg);
+            jit_emit_u64(jit, (uint64_t) operand.constant.integer);
+            break;
+        case COUNT_OPERAND_KINDS:
+        default:
+            UNREACHABLE("Unknown operand kind");
+    }
+}
+
+/**
+ * Emits a call to an integer helper taking its operands in rax and rcx, see vm_div_int.
+ * The result is stored through a slot of the stack frame and loaded back into rax,
+ * a failure of the helper jumps to the failure of the program.
+ *
+ * @param jit Pointer to the JIT.
+ * @param fn The helper.
+ * @param slot Displacement of the slot in the stack frame.
+ * @param fail Offset of the failure of the program.
+ */
+void jit_emit_call_int(Jit *jit, bool (*fn)(int64_t, int64_t, int64_t *), size_t slot, size_t fail)
+{
+    uint64_t address = (uint64_t) (uintptr_t) fn;
+    // mov rdi, rax; mov rsi, rcx; lea rdx, [rsp + slot]
+    JIT_EMIT(jit, 0x48, 0x89, 0xC7, 0x48, 0x89, 0xCE, 0x48, 0x8D, 0x94, 0x24);
+    jit_emit_u32(jit, (uint32_t) slot);
+    // mov rax, imm64; call rax; test al, al; jz fail
+    JIT_EMIT(jit, 0x48, 0xB8);
+    jit_emit_u64(jit, address);
+    JIT_EMIT(jit, 0xFF, 0xD0, 0x84, 0xC0);
+    jit_emit_jump(jit, 0x84, fail);
+    // mov rax, [rsp + slot]
+    JIT_EMIT(jit, 0x48, 0x8B, 0x84, 0x24);
+    jit_emit_u32(jit, (uint32_t) slot);
+}
+
+/**
+ * Translates the integer arithmetic of an integral program into native code,
+ * with the same failures as table_eval_expr_int: a cell operand that is not an integer,
+ * an overflow or an inexact result make the program return false.
+ *
+ * @param bc Pointer to the bytecode.
+ * @param program Pointer to the program to translate.
+ * @param cols Number of columns of the table.
+ */
+void jit_compile_program_int(Bytecode *bc, Program *program, size_t cols)
+{
+    Jit *jit = &bc->jit;
+    // Three registers are pushed over the return address: the frame keeps the stack aligned
+    // to 16 bytes for the calls of the helpers and ends with the slot of their results
+    size_t slot = program->regs * sizeof(int64_t);
+    size_t frame = (slot + sizeof(int64_t) + 15) & ~(size_t) 15;
+
+    // The failure comes first, so that every check jumps back to it
+    size_t fail = jit->count;
+    // fail: xor eax, eax; return: add rsp, frame; pop r13; pop r12; pop rbx; ret
+    JIT_EMIT(jit, 0x31, 0xC0);
+    size_t ret = jit->count;
+    JIT_EMIT(jit, 0x48, 0x81, 0xC4);
+    jit_emit_u32(jit, (uint32_t) frame);
+    JIT_EMIT(jit, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3);
+
+    size_t entry = jit->count;
+    // push rbx; push r12; push r13; lea rbx, [rdi + rdx*8]; lea r12, [rsi + rdx]; mov r13, rcx; sub rsp, frame
+    JIT_EMIT(jit, 0x53, 0x41, 0x54, 0x41, 0x55, 0x48, 0x8D, 0x1C, 0xD7, 0x4C, 0x8D, 0x24, 0x16,
+             0x49, 0x89, 0xCD, 0x48, 0x81, 0xEC);
+    jit_emit_u32(jit, (uint32_t) frame);
+
+    for(size_t pc = program->start;; ++pc) {
+        const Inst *inst = &bc->items[pc];
+        const Operand_Kind *kinds = inst_operand_kinds[inst->kind];
+
+        jit_emit_load_int(jit, 0, kinds[0], inst->a, cols, fail);
+        if(kinds[1] != COUNT_OPERAND_KINDS) {
+            jit_emit_load_int(jit, 1, kinds[1], inst->b, cols, fail);
+        }
+
+        switch(inst->kind) {
+            case INST_LOAD_CONST:
+            case INST_LOAD_CELL:
+                break;
+            case INST_NEG_REG:
+            case INST_NEG_CELL:
+                JIT_EMIT(jit, 0x48, 0xF7, 0xD8); // neg rax
+                jit_emit_jump(jit, 0x80, fail);
+                break;
+#define X(name, kind, fn, int_fn, lhs_kind, rhs_kind) case INST_##name##_##lhs_kind##_##rhs_kind:
+            VM_SHAPES(X, ADD, BOP_KIND_PLUS, vm_add, vm_add_int)
+                JIT_EMIT(jit, 0x48, 0x01, 0xC8); // add rax, rcx
+                jit_emit_jump(jit, 0x80, fail);
+                break;
+            VM_SHAPES(X, SUB, BOP_KIND_MINUS, vm_sub, vm_sub_int)
+                JIT_EMIT(jit, 0x48, 0x29, 0xC8); // sub rax, rcx
+                jit_emit_jump(jit, 0x80, fail);
+                break;
+            VM_SHAPES(X, MUL, BOP_KIND_MULT, vm_mul, vm_mul_int)
+                JIT_EMIT(jit, 0x48, 0x0F, 0xAF, 0xC1); // imul rax, rcx
+                jit_emit_jump(jit, 0x80, fail);
+                break;
+            VM_SHAPES(X, DIV, BOP_KIND_DIV, vm_div, vm_div_int)
+                jit_emit_call_int(jit, vm_div_int, slot, fail);
+                break;
+            VM_SHAPES(X, POW, BOP_KIND_POW, vm_pow, vm_pow_int)
+                jit_emit_call_int(jit, vm_pow_int, slot, fail);
+                break;
+            VM_SHAPES(X, MOD, BOP_KIND_MOD, vm_mod, vm_mod_int)
+                jit_emit_call_int(jit, vm_mod_int, slot, fail);
+                break;
+#undef X
+            case INST_RET: {
+                // mov [r13], rax; mov eax, 1; jmp return
+                JIT_EMIT(jit, 0x49, 0x89, 0x45, 0x00, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xE9);
+                jit_emit_u32(jit, (uint32_t) (int32_t) ((ptrdiff_t) ret - (ptrdiff_t) (jit->count + 4)));
+            } break;
+            case COUNT_INST_KINDS:
+            default:
+                UNREACHABLE("Unknown instruction kind");
+        }
+
+        if(inst->kind == INST_RET) break;
+
+        // mov [rsp + disp32], rax
+        JIT_EMIT(jit, 0x48, 0x89, 0x84, 0x24);
+        jit_emit_u32(jit, (uint32_t) (inst->dst * sizeof(int64_t)));
+    }
+
+    program->native_int = entry + 1;
+}
+
+/**
+ * Translates a program of the register machine into native code.
+ * Programs whose cell operands lie too far into the table for 32-bit
+ * displacements are left to the interpreter.
+ *
+ * @param bc Pointer to the bytecode.
+ * @param program_index Index of the program to translate.
+ * @param cols Number of columns of the table.
+ */
+void jit_compile_program(Bytecode *bc, size_t program_index, size_t cols)
+{
+    Jit *jit = &bc->jit;
+    Program *program = &bc->programs[program_index];
+    if(program->native != 0) return;
+    if(program->cells > 0 && program->max.row * cols + program->max.col > INT32_MAX / sizeof(uint64_t)) return;
+
+    size_t entry = jit->count;
+    // Two registers are pushed over the return address: keep the stack
+    // aligned to 16 bytes for the calls of the helpers
+    size_t frame = ((program->regs * sizeof(double) + 15) & ~(size_t) 15) + 8;
+
+    // push rbx; push r12; lea rbx, [rdi + rdx*8]; lea r12, [rsi + rdx]; sub rsp, frame
+    JIT_EMIT(jit, 0x53, 0x41, 0x54, 0x48, 0x8D, 0x1C, 0xD7, 0x4C, 0x8D, 0x24, 0x16, 0x48, 0x81, 0xEC);
+    jit_emit_u32(jit, (uint32_t) frame);
+
+    for(size_t pc = program->start;; ++pc) {
+        const Inst *inst = &bc->items[pc];
+        const Operand_Kind *kinds = inst_operand_kinds[inst->kind];
+
+        jit_emit_load(jit, 0, kinds[0], inst->a, cols);
+        if(kinds[1] != COUNT_OPERAND_KINDS) {
+            jit_emit_load(jit, 1, kinds[1], inst->b, cols);
+        }
+
+        switch(inst->kind) {
+            case INST_LOAD_CONST:
+            case INST_LOAD_CELL:
+                break;
+            case INST_NEG_REG:
+            case INST_NEG_CELL:
+                // mov rax, sign mask; movq xmm1, rax; xorpd xmm0, xmm1
+                JIT_EMIT(jit, 0x48, 0xB8);
+                jit_emit_u64(jit, 0x8000000000000000ULL);
+                JIT_EMIT(jit, 0x66, 0x48, 0x0F, 0x6E, 0xC8);
+                JIT_EMIT(jit, 0x66, 0x0F, 0x57, 0xC1);
+                break;
+#define X(name, kind, fn, int_fn, lhs_kind, rhs_kind) case INST_##name##_##lhs_kind##_##rhs_kind:
+            VM_SHAPES(X, ADD, BOP_KIND_PLUS, vm_add, vm_add_int)
+                JIT_EMIT(jit, 0xF2, 0x0F, 0x58, 0xC1); // addsd xmm0, xmm1
+                break;
+            VM_SHAPES(X, SUB, BOP_KIND_MINUS, vm_sub, vm_sub_int)
+                JIT_EMIT(jit, 0xF2, 0x0F, 0x5C, 0xC1); // subsd xmm0, xmm1
+                break;
+            VM_SHAPES(X, MUL, BOP_KIND_MULT, vm_mul, vm_mul_int)
+                JIT_EMIT(jit, 0xF2, 0x0F, 0x59, 0xC1); // mulsd xmm0, xmm1
+                break;
+            VM_SHAPES(X, DIV, BOP_KIND_DIV, vm_div, vm_div_int)
+                // Not a plain divsd, a division by zero is a #DIV/0! error
+                jit_emit_call(jit, vm_div);
+                break;
+            VM_SHAPES(X, POW, BOP_KIND_POW, vm_pow, vm_pow_int)
+                jit_emit_call(jit, vm_pow);
+                break;
+            VM_SHAPES(X, MOD, BOP_KIND_MOD, vm_mod, vm_mod_int)
+                jit_emit_call(jit, vm_mod);
+                break;
+#undef X
+            case INST_RET:
+                // add rsp, frame; pop r12; pop rbx; ret
+                JIT_EMIT(jit, 0x48, 0x81, 0xC4);
+                jit_emit_u32(jit, (uint32_t) frame);
+                JIT_EMIT(jit, 0x41, 0x5C, 0x5B, 0xC3);
+                break;
+            case COUNT_INST_KINDS:
+            default:
+                UNREACHABLE("Unknown instruction kind");
+        }
+
+        if(inst->kind == INST_RET) break;
+
+        // movsd [rsp + disp32], xmm0
+        JIT_EMIT(jit, 0xF2, 0x0F, 0x11, 0x84, 0x24);
+        jit_emit_u32(jit, (uint32_t) (inst->dst * sizeof(double)));
+    }
+
+    program->native = entry + 1;
+    if(program->integral) jit_compile_program_int(bc, program, cols);
+}
+
+#endif // JIT_SUPPORTED
+
+/**
+ * Finds the cell referenced by a formula. The cell must have been evaluated
+ * before the formula is executed, see table_eval_cell. A reference outside
+ * of the table is a #REF! error and a reference to a text cell a #VALUE! error.
+ *
+ * @param table Pointer to the table structure.
+ * @param ref The cell reference of the formula template.
+ * @param offset Offset of the formula template of the evaluating cell.
+ * @param out Pointer to store the row-major position of the evaluated number or expression cell.
+ * @return The error the reference loads, ERROR_KIND_NONE if it loads the value of the cell.
+ */
+Error_Kind table_load_cell(const Table *table, Cell_Index ref, Cell_Offset offset, size_t *out)
+{
+    Cell_Index target_index = {0};
+    if(!table_offset_index(table, ref, offset, &target_index)) {
+        return ERROR_KIND_REF;
+    }
+
+    size_t target = target_index.row * table->cols + target_index.col;
+    switch(table_kind(table, target)) {
+        case CELL_KIND_NUMBER:
+        case CELL_KIND_EXPR:
+            assert(table_evaluated(table, target));
+            *out = target;
+            return ERROR_KIND_NONE;
+        case CELL_KIND_TEXT:
+            return ERROR_KIND_VALUE;
+        case CELL_KIND_CLONE:
+            UNREACHABLE("Clone cell should be evaluated to the expression cell at this point");
+        default:
+            UNREACHABLE("Unknown cell kind");
+    }
+}
+
+/**
+ * Loads the value of a cell referenced by a formula as a double.
+ * See table_load_cell for the parameters.
+ *
+ * @return The value of the cell or the error.
+ */
+double table_load_number(const Table *table, Cell_Index ref, Cell_Offset offset)
+{
+    size_t cell = 0;
+    Error_Kind error = table_load_cell(table, ref, offset, &cell);
+    if(error != ERROR_KIND_NONE) return error_value(error);
+    return value_number(table_type(table, cell), table_value(table, cell));
+}
+
+/**
+ * Loads the value of a cell referenced by a formula as an integer.
+ * See table_load_cell for the parameters.
+ *
+ * @param out Pointer to store the value of the cell.
+ * @return true if the cell holds an integer, false otherwise.
+ */
+bool table_load_int(const Table *table, Cell_Index ref, Cell_Offset offset, int64_t *out)
+{
+    size_t cell = 0;
+    if(table_load_cell(table, ref, offset, &cell) != ERROR_KIND_NONE) return false;
+    if(table_type(table, cell) != VALUE_TYPE_INT) return false;
+    *out = table_value(table, cell).integer;
+    return true;
+}
+
+/**
+ * Reserves a frame on the shared stack of the virtual machine.
+ * The frame is released by resetting the top of the stack to its base.
+ *
+ * @param bc Pointer to the bytecode.
+ * @param size Number of values in the frame.
+ * @return The base of the frame.
+ */
+size_t bytecode_push_frame(Bytecode *bc, size_t size)
+{
+    size_t base = bc->stack_top;
+    if(base + size > bc->stack_capacity) {
+        while(base + size > bc->stack_capacity) {
+            bc->stack_capacity = bc->stack_capacity == 0 ? 256 : bc->stack_capacity * 2;
+        }
+        bc->stack = realloc(bc->stack, sizeof(*bc->stack) * bc->stack_capacity);
+    }
+    bc->stack_top = base + size;
+    return base;
+}
+
+// Threaded dispatch through computed goto where the compiler supports it,
+// falling back to a plain switch otherwise.
+#if defined(__GNUC__) && !defined(VM_NO_COMPUTED_GOTO)
+#define VM_COMPUTED_GOTO
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+#define VM_LABELS                                                                   \
+    static void *const labels[COUNT_INST_KINDS] = {                                 \
+        [INST_LOAD_CONST] = &&op_INST_LOAD_CONST,                                   \
+        [INST_LOAD_CELL]  = &&op_INST_LOAD_CELL,                                    \
+        [INST_NEG_REG]    = &&op_INST_NEG_REG,                                      \
+        [INST_NEG_CELL]   = &&op_INST_NEG_CELL,                                     \
+        VM_BOP_SHAPES(VM_LABEL)                                                     \
+        [INST_RET]        = &&op_INST_RET,                                          \
+    }
+#define VM_LABEL(name, kind, fn, int_fn, a, b) [INST_##name##_##a##_##b] = &&op_INST_##name##_##a##_##b,
+#define VM_DISPATCH() VM_LABELS; VM_NEXT()
+#define VM_NEXT() do { inst = &bc->items[pc++]; goto *labels[inst->kind]; } while(0)
+#define VM_OP(kind) op_##kind
+#define VM_END()
+#else
+#define VM_DISPATCH() dispatch: inst = &bc->items[pc++]; switch(inst->kind) {
+#define VM_NEXT() goto dispatch
+#define VM_OP(kind) case kind
+#define VM_END() case COUNT_INST_KINDS: default: UNREACHABLE("Unknown instruction kind"); }
+#endif
+
+/**
+ * Executes an integral program with integer arithmetic, by the register machine
+ * or by its native code if the JIT has compiled it.
+ * Cell references of the program are resolved relative to the evaluating cell,
+ * i.e. displaced by the offset of its formula template.
+ *
+ * @param table Pointer to the table structure.
+ * @param bc Pointer to the bytecode.
+ * @param program The program to execute.
+ * @param offset Offset of the formula template of the evaluating cell.
+ * @param out Pointer to store the result.
+ * @return true on success, false if a referenced cell is not an integer or the arithmetic overflows.
+ */
+bool table_eval_expr_int(const Table *table, Bytecode *bc, Program program, Cell_Offset offset, int64_t *out)
+{
+    // A reference out of the table fails as in the interpreter, see table_eval_expr_number
+    if(bc->jit.code != NULL && program.native_int != 0 && (program.cells == 0 ||
+       (table_offset_index(table, program.min, offset, NULL) && table_offset_index(table, program.max, offset, NULL)))) {
+        Jit_Int_Fn fn = (Jit_Int_Fn) (uintptr_t) (bc->jit.code + program.native_int - 1);
+        return fn(table->words, table->flags, offset.row * (ptrdiff_t) table->cols + offset.col, out);
+    }
+
+    size_t pc = program.start;
+    size_t base = bytecode_push_frame(bc, program.regs);
+    const Inst *inst = NULL;
+
+    // The cells referenced by the program are evaluated before it runs,
+    // so loading them never runs nested programs that could move the stack
+    Vm_Value *regs = &bc->stack[base];
+#define VM_REG(reg) (regs[(reg)].integer)
+#define VM_OPERAND_REG(operand, out) (*(out) = VM_REG((operand).reg), true)
+#define VM_OPERAND_CELL(operand, out) table_load_int(table, (operand).cell, offset, (out))
+#define VM_OPERAND_CONST(operand, out) (*(out) = (operand).constant.integer, true)
+
+    VM_DISPATCH();
+
+    VM_OP(INST_LOAD_CONST):
+        VM_REG(inst->dst) = inst->a.constant.integer;
+        VM_NEXT();
+    VM_OP(INST_LOAD_CELL): {
+        int64_t value = 0;
+        if(!VM_OPERAND_CELL(inst->a, &value)) goto fail;
+        VM_REG(inst->dst) = value;
+    } VM_NEXT();
+    VM_OP(INST_NEG_REG): {
+        int64_t value = 0;
+        if(!vm_neg_int(VM_REG(inst->a.reg), &value)) goto fail;
+        VM_REG(inst->dst) = value;
+    } VM_NEXT();
+    VM_OP(INST_NEG_CELL): {
+        int64_t value = 0;
+        if(!VM_OPERAND_CELL(inst->a, &value) || !vm_neg_int(value, &value)) goto fail;
+        VM_REG(inst->dst) = value;
+    } VM_NEXT();
+
+#define X(name, kind, fn, int_fn, lhs_kind, rhs_kind)               \
+    VM_OP(INST_##name##_##lhs_kind##_##rhs_kind): {                 \
+        int64_t lhs = 0, rhs = 0, result = 0;                       \
+        if(!VM_OPERAND_##lhs_kind(inst->a, &lhs)) goto fail;        \
+        if(!VM_OPERAND_##rhs_kind(inst->b, &rhs)) goto fail;        \
+        if(!int_fn(lhs, rhs, &result)) goto fail;                   \
+        VM_REG(inst->dst) = result;                                 \
+    } VM_NEXT();
+    VM_BOP_SHAPES(X)
+#undef X
+
+    VM_OP(INST_RET):
+        *out = VM_REG(inst->a.reg);
+        bc->stack_top = base;
+        return true;
+
+    VM_END()
+
+fail:
+    bc->stack_top = base;
+    return false;
+
+#undef VM_REG
+#undef VM_OPERAND_REG
+#undef VM_OPERAND_CELL
+#undef VM_OPERAND_CONST
+}
+
+/**
+ * Executes a program with floating point arithmetic, by the register machine
+ * or by its native code if the JIT has compiled it.
+ * See table_eval_expr_int for the parameters.
+ *
+ * @return The numeric result of the program.
+ */
+double table_eval_expr_number(const Table *table, Bytecode *bc, Program program, Cell_Offset offset)
+{
+    // The native code loads the cell operands itself, but a reference out of the table
+    // is a #REF! error reported by the interpreter
+    if(bc->jit.code != NULL && program.native != 0 && (program.cells == 0 ||
+       (table_offset_index(table, program.min, offset, NULL) && table_offset_index(table, program.max, offset, NULL)))) {
+        Jit_Fn fn = (Jit_Fn) (uintptr_t) (bc->jit.code + program.native - 1);
+        return fn(table->words, table->flags, offset.row * (ptrdiff_t) table->cols + offset.col);
+    }
+
+    size_t pc = program.start;
+    const Inst *inst = NULL;
+
+    // Reserve the frame of this execution on the shared stack
+    size_t base = bytecode_push_frame(bc, program.regs);
+
+    Vm_Value *regs = &bc->stack[base];
+#define VM_REG(reg) (regs[(reg)].number)
+#define VM_OPERAND_REG(operand) VM_REG((operand).reg)
+#define VM_OPERAND_CELL(operand) table_load_number(table, (operand).cell, offset)
+#define VM_OPERAND_CONST(operand) ((operand).constant.number)
+
+    VM_DISPATCH();
+
+    VM_OP(INST_LOAD_CONST):
+        VM_REG(inst->dst) = inst->a.constant.number;
+        VM_NEXT();
+    VM_OP(INST_LOAD_CELL): {
+        double value = VM_OPERAND_CELL(inst->a);
+        VM_REG(inst->dst) = value;
+    } VM_NEXT();
+    VM_OP(INST_NEG_REG):
+        VM_REG(inst->dst) = -VM_REG(inst->a.reg);
+        VM_NEXT();
+    VM_OP(INST_NEG_CELL): {
+        double value = VM_OPERAND_CELL(inst->a);
+        VM_REG(inst->dst) = -value;
+    } VM_NEXT();
+
+#define X(name, kind, fn, int_fn, lhs_kind, rhs_kind)       \
+    VM_OP(INST_##name##_##lhs_kind##_##rhs_kind): {         \
+        double lhs = VM_OPERAND_##lhs_kind(inst->a);        \
+        double rhs = VM_OPERAND_##rhs_kind(inst->b);        \
+        VM_REG(inst->dst) = fn(lhs, rhs);                   \
+    } VM_NEXT();
+    VM_BOP_SHAPES(X)
+#undef X
+
+    VM_OP(INST_RET): {
+        double result = VM_REG(inst->a.reg);
+        bc->stack_top = base;
+        return result;
+    }
+
+    VM_END()
+
+#undef VM_REG
+#undef VM_OPERAND_REG
+#undef VM_OPERAND_CELL
+#undef VM_OPERAND_CONST
+}
+
+#undef VM_DISPATCH
+#undef VM_NEXT
+#undef VM_OP
+#undef VM_END
+
+#ifdef VM_COMPUTED_GOTO
+#undef VM_LABELS
+#undef VM_LABEL
+#pragma GCC diagnostic pop
+#endif
+
+/**
+ * Evaluates an expression in the context of a table and stores the result into the evaluating cell.
+ * The formula is compiled into bytecode once. Integral formulas are executed with integer
+ * arithmetic first; if a referenced cell is not an integer or the arithmetic overflows,
+ * the formula is executed again with doubles.
+ *
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode.
+ * @param cell_index Index of the expression cell being evaluated.
+ */
+void table_eval_expr(Table *table, Expr_Buffer *eb, Bytecode *bc, Cell_Index cell_index) 
+{
+    size_t cell = table_cell_at(table, cell_index);
+    Cell_Expr expr = *table_formula(table, cell);
+    // Copied since nested evaluations may compile new programs and move the programs
+    Program program = *bytecode_program(bc, eb, expr.index);
+
+    int64_t integer = 0;
+    if(program.integral && table_eval_expr_int(table, bc, program, expr.offset, &integer)) {
+        table_set_integer(table, cell, integer);
+        return;
+    }
+
+    table_set_number(table, cell, table_eval_expr_number(table, bc, program, expr.offset));
+}
+
+/**
+ * Returns the opposite direction.
+ * LEFT <-> RIGHT, UP <-> DOWN
+ *
+ * @param dir The direction to reverse.
+ * @return The opposite direction.
+ */
+Dir opposite_dir(Dir dir) 
+{
+    switch(dir) {
+        case DIR_LEFT: return DIR_RIGHT;
+        case DIR_RIGHT: return DIR_LEFT;
+        case DIR_UP: return DIR_DOWN;
+        case DIR_DOWN: return DIR_UP;
+        default: {
+            UNREACHABLE("Unknown direction");
+        }
+    }
+}
+
+/**
+ * Returns the cell index of a neighboring cell in the specified direction.
+ *
+ * @param index The starting cell index.
+ * @param dir The direction to move.
+ * @return The new cell index.
+ */
+Cell_Index nbor_in_dir(Cell_Index index, Dir dir) 
+{
+    switch(dir) {
+        case DIR_LEFT:
+            index.col --;
+            break;
+        case DIR_RIGHT:
+            index.col ++;
+            break;
+        case DIR_UP:
+            index.row --;
+            break;
+        case DIR_DOWN:
+            index.row ++;
+            break;
+        default: {
+            UNREACHABLE("Unknown direction");
+        }
+    }
+
+    return index;
+}
+
+/**
+ * Shifts an offset by one cell in the specified direction.
+ *
+ * @param offset The offset to shift.
+ * @param dir The direction to shift.
+ * @return The shifted offset.
+ */
+Cell_Offset offset_in_dir(Cell_Offset offset, Dir dir) 
+{
+    switch(dir) {
+        case DIR_LEFT:
+            offset.col --;
+            break;
+        case DIR_RIGHT:
+            offset.col ++;
+            break;
+        case DIR_UP:
+            offset.row --;
+            break;
+        case DIR_DOWN:
+            offset.row ++;
+            break;
+        default: {
+            UNREACHABLE("Unknown direction");
+        }
+    }
+
+    return offset;
+}
+
+/**
+ * Compares two sizes, for sorting them with qsort.
+ *
+ * @param a Pointer to the first size.
+ * @param b Pointer to the second size.
+ * @return Negative, zero or positive if the first size is less, equal or greater.
+ */
+int compare_size(const void *a, const void *b)
+{
+    size_t lhs = *(const size_t *) a;
+    size_t rhs = *(const size_t *) b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+/**
+ * Reports a circular dependency with all the cells taking part in it and turns
+ * the cells into #CYCLE! errors, which the cells reading them then propagate.
+ *
+ * @param table Pointer to the table structure.
+ * @param cells Row-major indices of the cells of the cycle, sorted in place.
+ * @param count Number of the cells.
+ */
+void table_report_cycle(Table *table, size_t *cells, size_t count)
+{
+    qsort(cells, count, sizeof(*cells), compare_size);
+
+    Cell_Location first = table_location(table, cells[0]);
+    fprintf(stderr, "%s:%zu:%zu: WARNING: circular dependency is detected!\n", table->file_path, first.file_row, first.file_col);
+    fprintf(stderr, "%s:%zu:%zu: NOTE: the cycle goes through %zu cell%s:", table->file_path, first.file_row, first.file_col,
+        count, count == 1 ? "" : "s");
+    for(size_t k = 0; k < count; ++k) {
+        fprintf(stderr, "%s %c%zu", k == 0 ? "" : ",", (char) ('A' + cells[k] % table->cols), cells[k] / table->cols);
+    }
+    fprintf(stderr, "\n");
+
+    for(size_t k = 0; k < count; ++k) {
+        table_set_error(table, cells[k], ERROR_KIND_CYCLE);
+    }
+}
+
+/**
+ * Pushes a cell onto the work stack of the evaluation.
+ *
+ * @param bc Pointer to the bytecode.
+ * @param cell_index Index of the cell to push.
+ */
+void table_push_eval(Bytecode *bc, Cell_Index cell_index)
+{
+    if(bc->evals_count >= bc->evals_capacity) {
+        bc->evals_capacity = bc->evals_capacity == 0 ? 256 : bc->evals_capacity * 2;
+        bc->evals = realloc(bc->evals, sizeof(*bc->evals) * bc->evals_capacity);
+    }
+    bc->evals[bc->evals_count++] = (Eval_Frame) { .cell = cell_index };
+}
+
+/**
+ * Checks the cells referenced by the formula of the cell on top of the work stack
+ * in the order the formula loads them, pushing the first one that is not evaluated yet.
+ * The checked operands are skipped when the cell gets back to the top of the stack.
+ *
+ * @param table Pointer to the table structure.
+ * @param bc Pointer to the bytecode.
+ * @return true if every referenced cell is evaluated, false if one has been pushed.
+ */
+bool table_eval_deps(Table *table, Bytecode *bc)
+{
+    Eval_Frame *frame = &bc->evals[bc->evals_count - 1];
+    Cell_Offset offset = table_formula(table, table_cell_at(table, frame->cell))->offset;
+
+    for(;; frame->pc += 1, frame->operand = 0) {
+        const Inst *inst = &bc->items[frame->pc];
+        for(; frame->operand < 2; frame->operand += 1) {
+            if(inst_operand_kinds[inst->kind][frame->operand] != OPERAND_CELL) continue;
+
+            // References outside of the table load #REF! errors, there is nothing to evaluate
+            Cell_Index ref = frame->operand == 0 ? inst->a.cell : inst->b.cell;
+            Cell_Index target_index = {0};
+            if(!table_offset_index(table, ref, offset, &target_index)) continue;
+            if(!table_evaluated(table, table_cell_at(table, target_index))) {
+                table_push_eval(bc, target_index);
+                return false;
+            }
+        }
+        if(inst->kind == INST_RET) return true;
+    }
+}
+
+void table_report_cone_cycles(Table *table, Expr_Buffer *eb, Bytecode *bc, const size_t *cells, size_t count);
+
+/**
+ * Evaluates a cell in the table together with every cell it depends on.
+ * Handles different cell types and their evaluation rules.
+ *
+ * The dependencies are evaluated depth first in the order the formulas reference them,
+ * but on an explicit work stack, so the length of a chain of dependencies is not limited
+ * by the size of the C stack. A cell has the flag CELL_FLAG_INPROGRESS while it is on the work stack.
+ * The clones of the table must have been resolved with table_resolve_clones.
+ *
+ * A cell pushed while it is on the stack depends on itself. The whole strongly connected
+ * components of the cells the evaluated cell depends on are then turned into #CYCLE! errors
+ * by table_report_cone_cycles and the evaluation starts over, so the cells get the values
+ * of a full run whatever cell of a cycle is evaluated first.
+ *
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode.
+ * @param cell_index Index of the cell to evaluate.
+ */
+void table_eval_cell(Table *table, Expr_Buffer *eb, Bytecode *bc, Cell_Index cell_index) 
+{
+    if(table_evaluated(table, table_cell_at(table, cell_index))) return;
+
+    size_t bottom = bc->evals_count;
+    table_push_eval(bc, cell_index);
+
+    while(bc->evals_count > bottom) {
+        Eval_Frame *frame = &bc->evals[bc->evals_count - 1];
+        size_t cell = table_cell_at(table, frame->cell);
+
+        switch(table_kind(table, cell)) {
+            case CELL_KIND_TEXT:
+            case CELL_KIND_NUMBER:
+                bc->evals_count -= 1;
+                break;
+
+            case CELL_KIND_EXPR: {
+                if(!frame->started && (table->flags[cell] & CELL_FLAG_INPROGRESS)) {
+                    for(size_t k = bottom; k < bc->evals_count; ++k) {
+                        table->flags[table_cell_at(table, bc->evals[k].cell)] &= ~CELL_FLAG_INPROGRESS;
+                    }
+                    bc->evals_count = bottom;
+
+                    size_t root = table_cell_at(table, cell_index);
+                    table_report_cone_cycles(table, eb, bc, &root, 1);
+                    if(!table_evaluated(table, root)) table_push_eval(bc, cell_index);
+                    break;
+                }
+
+                if(!frame->started) {
+                    table->flags[cell] |= CELL_FLAG_INPROGRESS;
+                    frame->started = true;
+                    frame->pc = bytecode_program(bc, eb, table_formula(table, cell)->index)->start;
+                    frame->operand = 0;
+                }
+
+                if(!table_eval_deps(table, bc)) break;
+
+                table_eval_expr(table, eb, bc, frame->cell);
+                bc->evals_count -= 1;
+            } break;
+
+            case CELL_KIND_CLONE:
+                UNREACHABLE("Clones are resolved before the evaluation");
+
+            default:
+                UNREACHABLE("Unknown cell kind");
+        }
+    }
+}
+
+/**
+ * Turns a clone cell into a copy of its neighbor, unless the neighbor is a clone itself
+ * or lies outside of the table. Clones of expression cells share the template of the
+ * cloned formula, only with the offset shifted by one cell.
+ *
+ * @param table Pointer to the table structure.
+ * @param index Index of the clone cell.
+ * @return true if the clone has been resolved.
+ */
+bool table_copy_clone(Table *table, Cell_Index index)
+{
+    size_t cell = table_cell_at(table, index);
+    Dir dir = table_clone(table, cell);
+    Cell_Index nbor_index = nbor_in_dir(index, dir);
+    if(nbor_index.row >= table->rows || nbor_index.col >= table->cols) return false;
+
+    size_t nbor = table_cell_at(table, nbor_index);
+    switch(table_kind(table, nbor)) {
+        case CELL_KIND_CLONE:
+            return false;
+
+        case CELL_KIND_EXPR: {
+            Cell_Expr expr = *table_formula(table, nbor);
+            expr.offset = offset_in_dir(expr.offset, opposite_dir(dir));
+            table_set_formula(table, cell, expr);
+        } break;
+
+        case CELL_KIND_TEXT:
+        case CELL_KIND_NUMBER:
+            table->words[cell] = table->words[nbor];
+            table->flags[cell] = table->flags[nbor];
+            break;
+
+        default:
+            UNREACHABLE("Unknown cell kind");
+    }
+    return true;
+}
+
+/**
+ * Turns every clone cell into a copy of the cell it clones, without evaluating anything,
+ * so that the evaluation never sees clones. Clones of expression cells share the template
+ * of the cloned formula with the offset shifted by the distance to it.
+ *
+ * A forward sweep in row-major order resolves runs of clones of the cells above or to the
+ * left, like formulas cloned down a column or along a row, one cell after another. A backward
+ * sweep does the same for the clones of the cells below or to the right. Only the clones
+ * whose chains change direction against the sweeps are left to follow chain by chain,
+ * which also turns circular clones into #CYCLE! errors and clones of cells outside
+ * of the table into #REF! errors.
+ *
+ * @param table Pointer to the table structure.
+ */
+void table_resolve_clones(Table *table)
+{
+    size_t cells_count = table->rows * table->cols;
+
+    // Every clone may become an expression cell
+    size_t clones_count = 0;
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(table_kind(table, i) == CELL_KIND_CLONE) clones_count += 1;
+    }
+    table_reserve_formulas(table, clones_count);
+
+    // Range of the clones left by the sweeps
+    size_t first = cells_count;
+    size_t last = 0;
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(table_kind(table, i) != CELL_KIND_CLONE) continue;
+        Cell_Index index = { .row = i / table->cols, .col = i % table->cols };
+        if(table_copy_clone(table, index)) continue;
+        if(first > i) first = i;
+        last = i;
+    }
+    if(first >= cells_count) return;
+
+    size_t backward_first = cells_count;
+    size_t backward_last = 0;
+    for(size_t i = last + 1; i-- > first;) {
+        if(table_kind(table, i) != CELL_KIND_CLONE) continue;
+        Cell_Index index = { .row = i / table->cols, .col = i % table->cols };
+        if(table_copy_clone(table, index)) continue;
+        if(backward_last < i) backward_last = i;
+        backward_first = i;
+    }
+    if(backward_first >= cells_count) return;
+
+    Cell_Index *chain = NULL;
+    size_t chain_count = 0;
+    size_t chain_capacity = 0;
+
+    for(size_t i = backward_first; i <= backward_last; ++i) {
+        Cell_Index index = { .row = i / table->cols, .col = i % table->cols };
+
+        // Follow the chain of clones down to the cell they copy
+        chain_count = 0;
+        for(size_t cell = table_cell_at(table, index); table_kind(table, cell) == CELL_KIND_CLONE; cell = table_cell_at(table, index)) {
+            if(table->flags[cell] & CELL_FLAG_INPROGRESS) {
+                // The chain runs into a cycle of clones from this cell on, the cycle becomes
+                // #CYCLE! errors and the rest of the chain copies them
+                size_t start = chain_count;
+                while(chain[start - 1].row != index.row || chain[start - 1].col != index.col) {
+                    start -= 1;
+                }
+                start -= 1;
+
+                size_t *cycle = malloc(sizeof(*cycle) * (chain_count - start));
+                for(size_t k = start; k < chain_count; ++k) {
+                    cycle[k - start] = chain[k].row * table->cols + chain[k].col;
+                }
+                table_report_cycle(table, cycle, chain_count - start);
+                free(cycle);
+                chain_count = start;
+                break;
+            }
+            table->flags[cell] |= CELL_FLAG_INPROGRESS;
+
+            if(chain_count >= chain_capacity) {
+                chain_capacity = chain_capacity == 0 ? 64 : chain_capacity * 2;
+                chain = realloc(chain, sizeof(*chain) * chain_capacity);
+            }
+            chain[chain_count++] = index;
+
+            index = nbor_in_dir(index, table_clone(table, cell));
+            if(index.row >= table->rows || index.col >= table->cols) {
+                // Nothing to copy, the clone becomes a #REF! error and the rest of the chain copies it
+                table_set_error(table, cell, ERROR_KIND_REF);
+                chain_count -= 1;
+                break;
+            }
+        }
+
+        // Copy the cloned cell back along the chain
+        while(chain_count > 0) {
+            if(!table_copy_clone(table, chain[--chain_count])) {
+                UNREACHABLE("The end of a chain of clones is not a clone");
+            }
+        }
+    }
+
+    free(chain);
+}
+
+/**
+ * Rebuilds the formulas of the table in the row-major order of their cells, leaving out
+ * the formulas of the cells that are no expression cells anymore, and keeps the index of
+ * the formula of every expression cell aside, where table_formula finds it once the word
+ * of the cell holds its value. The clones and the patches append their formulas out of order.
+ * Every expression cell must not be evaluated yet.
+ *
+ * @param table Pointer to the table structure.
+ */
+void table_order_formulas(Table *table)
+{
+    size_t cells_count = table->rows * table->cols;
+    free(table->formula_indices);
+    table->formula_indices = malloc(sizeof(*table->formula_indices) * (cells_count + 1));
+    if(table->formula_indices == NULL) {
+        fprintf(stderr, "ERROR: could not allocate the indices of the formulas\n");
+        exit(1);
+    }
+
+    // The parser and the forward sweep over the clones mostly append the formulas in order already
+    bool ordered = true;
+    size_t count = 0;
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(!(table->flags[i] & CELL_FLAG_EXPR)) {
+            table->flags[i] &= ~CELL_FLAG_FORMULA;
+            continue;
+        }
+        assert(!table_evaluated(table, i));
+        if(count > UINT32_MAX) {
+            fprintf(stderr, "ERROR: the table has more than %"PRIu32" formulas\n", UINT32_MAX);
+            exit(1);
+        }
+        if(table->words[i] != (CELL_TAG_EXPR | count)) ordered = false;
+        table->formula_indices[i] = (uint32_t) count;
+        count += 1;
+    }
+    if(ordered && count == table->formulas_count) return;
+
+    Cell_Expr *formulas = malloc(sizeof(*formulas) * (count + 1));
+    size_t k = 0;
+    for(size_t i = 0; i < table->rows * table->cols; ++i) {
+        if(!(table->flags[i] & CELL_FLAG_EXPR)) continue;
+        formulas[k] = table->formulas[table->words[i] & CELL_PAYLOAD_MASK];
+        table->words[i] = CELL_TAG_EXPR | k;
+        k += 1;
+    }
+
+    free(table->formulas);
+    table->formulas = formulas;
+    table->formulas_count = count;
+    table->formulas_capacity = count + 1;
+}
+
+#define COLUMN_RUN_MIN_ROWS 16
+#define LINEAR_RUN_PARALLEL_ROWS 4096
+
+typedef enum {
+    RUN_KIND_LINEAR = 0, // Linear recurrence over the cell right above, evaluated as a prefix scan
+    RUN_KIND_BATCH,      // Cells reading no cell of the run, evaluated several rows at a time
+} Run_Kind;
+
+// Vertical run of cells sharing a formula template, like a formula cloned down a column.
+// A linear run computes `prev + term` or `coef*prev + term` over the cell right above,
+// like running totals do, and its first cell reads the seed right above the run.
+typedef struct {
+    Run_Kind kind;
+    size_t col;
+    size_t row_begin;
+    size_t row_end;
+    Program formula;    // Compiled shared formula
+    Value_Type type;    // Type of the shared formula
+    bool affine;        // The formula is `coef*prev + term` rather than `prev + term`
+    bool term_on_left;  // The term is the left operand of the addition
+    bool coef_on_left;  // The coefficient is the left operand of the multiplication
+    Program coef;       // Compiled coefficient, evaluated with the offset of every cell
+    Program term;       // Compiled term, evaluated with the offset of every cell
+    bool constant;      // The coefficient and the term read no cells
+} Column_Run;
+
+// Dependency graph of the expression cells in compressed sparse row form.
+// Cells are identified by their row-major position in the table. Only the
+// expression cells take part: number and text cells are never computed.
+typedef struct {
+    size_t cells_count;
+    size_t *deps_start;  // Dependencies of the cell i are deps[deps_start[i]..deps_start[i + 1]]
+    size_t *deps;        // Expression cells read by a formula, in the order it loads them
+    size_t *users_start; // Users of the cell i are users[users_start[i]..users_start[i + 1]]
+    size_t *users;       // Expression cells reading a cell
+    size_t *order;       // Expression cells in topological order: every cell follows its dependencies
+    size_t order_count;  // and the cells of a column run follow each other from the top
+
+    Column_Run *runs;
+    size_t runs_count;
+    size_t *run_by_cell; // Column run index plus one for every cell, 0 if the cell is in none
+    size_t linear_cells; // Number of cells in linear runs
+} Dep_Graph;
+
+/**
+ * Resolves the cells loaded by the formula of an expression cell, in the order the formula
+ * loads them. References outside of the table are left out, they load #REF! errors.
+ *
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode.
+ * @param cell Row-major index of the expression cell.
+ * @param deps Pointer to a scratch array for the row-major indices of the loaded cells, grown as needed.
+ * @param deps_capacity Pointer to the capacity of the scratch array.
+ * @return The number of the loaded cells.
+ */
+size_t table_formula_deps(Table *table, Expr_Buffer *eb, Bytecode *bc, size_t cell, size_t **deps, size_t *deps_capacity)
+{
+    Cell_Expr expr = *table_formula(table, cell);
+    const Program *program = bytecode_program(bc, eb, expr.index);
+
+    if(program->cells > *deps_capacity) {
+        *deps_capacity = program->cells;
+        *deps = realloc(*deps, sizeof(**deps) * *deps_capacity);
+        if(*deps == NULL) {
+            fprintf(stderr, "ERROR: could not allocate the dependencies of a formula\n");
+            exit(1);
+        }
+    }
+
+    size_t count = 0;
+    for(size_t pc = program->start;; ++pc) {
+        const Inst *inst = &bc->items[pc];
+        for(size_t k = 0; k < 2; ++k) {
+            if(inst_operand_kinds[inst->kind][k] != OPERAND_CELL) continue;
+
+            Cell_Index ref = k == 0 ? inst->a.cell : inst->b.cell;
+            Cell_Index dep = {0};
+            if(!table_offset_index(table, ref, expr.offset, &dep)) continue;
+            (*deps)[count++] = dep.row * table->cols + dep.col;
+        }
+        if(inst->kind == INST_RET) break;
+    }
+
+    return count;
+}
+
+/**
+ * Checks whether an expression is a reference to the cell right above the cell being evaluated.
+ *
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param expr_index Index of the expression.
+ * @param cell_index Position of the evaluated cell.
+ * @param offset Offset of the formula of the evaluated cell.
+ * @return true if the expression reads the cell above.
+ */
+bool expr_is_cell_above(const Table *table, const Expr_Buffer *eb, Expr_Index expr_index, Cell_Index cell_index, Cell_Offset offset)
+{
+    const Expr *expr = expr_buffer_at(eb, expr_index);
+    if(expr->kind != EXPR_KIND_CELL) return false;
+
+    Cell_Index target = {0};
+    if(!table_offset_index(table, expr->as.cell, offset, &target)) return false;
+    return target.row + 1 == cell_index.row && target.col == cell_index.col;
+}
+
+/**
+ * Matches the formula of an expression cell against the linear recurrences `prev + term`
+ * and `coef*prev + term`, where prev is the cell right above, in any operand order.
+ *
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param cell Row-major index of the expression cell.
+ * @param run Pointer to the run whose shape fields are filled on a match.
+ * @param coef Pointer to the index of the coefficient, set for `coef*prev + term` only.
+ * @param term Pointer to the index of the term.
+ * @return true if the formula is a linear recurrence.
+ */
+bool table_match_linear(const Table *table, const Expr_Buffer *eb, size_t cell, Column_Run *run, Expr_Index *coef, Expr_Index *term)
+{
+    Cell_Index cell_index = { .row = cell / table->cols, .col = cell % table->cols };
+    Cell_Expr expr = *table_formula(table, cell);
+    const Expr *root = expr_buffer_at(eb, expr.index);
+    if(root->kind != EXPR_KIND_BOP || root->as.bop.kind != BOP_KIND_PLUS) return false;
+
+    for(size_t side = 0; side < 2; ++side) {
+        Expr_Index prev_side = side == 0 ? root->as.bop.lhs : root->as.bop.rhs;
+        Expr_Index term_side = side == 0 ? root->as.bop.rhs : root->as.bop.lhs;
+
+        if(expr_is_cell_above(table, eb, prev_side, cell_index, expr.offset)) {
+            run->affine = false;
+            run->term_on_left = side == 1;
+            *term = term_side;
+            return true;
+        }
+
+        const Expr *mult = expr_buffer_at(eb, prev_side);
+        if(mult->kind != EXPR_KIND_BOP || mult->as.bop.kind != BOP_KIND_MULT) continue;
+        for(size_t factor = 0; factor < 2; ++factor) {
+            Expr_Index prev_factor = factor == 0 ? mult->as.bop.lhs : mult->as.bop.rhs;
+            if(expr_is_cell_above(table, eb, prev_factor, cell_index, expr.offset)) {
+                run->affine = true;
+                run->term_on_left = side == 1;
+                run->coef_on_left = factor == 1;
+                *coef = factor == 0 ? mult->as.bop.rhs : mult->as.bop.lhs;
+                *term = term_side;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Compiles the formula of every expression cell of the table into native code,
+ * with the terms and the coefficients of the linear recurrences, see table_match_linear,
+ * and maps the code as executable. Does nothing on targets without JIT support.
+ *
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode.
+ * @return true if the native code is available, false otherwise.
+ */
+bool jit_compile_table(Table *table, Expr_Buffer *eb, Bytecode *bc)
+{
+#ifdef JIT_SUPPORTED
+    for(size_t i = 0; i < table->rows * table->cols; ++i) {
+        if(table_kind(table, i) != CELL_KIND_EXPR) continue;
+
+        Expr_Index index = table_formula(table, i)->index;
+        bytecode_program(bc, eb, index);
+        jit_compile_program(bc, bc->program_by_expr[index] - 1, table->cols);
+
+        // The linear runs evaluate their terms and coefficients instead of the whole formulas
+        Column_Run run = {0};
+        Expr_Index coef = 0;
+        Expr_Index term = 0;
+        if(table_match_linear(table, eb, i, &run, &coef, &term)) {
+            bytecode_program(bc, eb, term);
+            jit_compile_program(bc, bc->program_by_expr[term] - 1, table->cols);
+            if(run.affine) {
+                bytecode_program(bc, eb, coef);
+                jit_compile_program(bc, bc->program_by_expr[coef] - 1, table->cols);
+            }
+        }
+    }
+
+    Jit *jit = &bc->jit;
+    if(jit->count == 0) return false;
+
+    jit->code_size = jit->count;
+    void *code = mmap(NULL, jit->code_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(code == MAP_FAILED) {
+        fprintf(stderr, "ERROR: could not map memory for the native code: %s\n", strerror(errno));
+        exit(1);
+    }
+    memcpy(code, jit->items, jit->count);
+    if(mprotect(code, jit->code_size, PROT_READ | PROT_EXEC) < 0) {
+        fprintf(stderr, "ERROR: could not make the native code executable: %s\n", strerror(errno));
+        exit(1);
+    }
+    jit->code = code;
+    return true;
+#else
+    (void) table;
+    (void) eb;
+    (void) bc;
+    return false;
+#endif
+}
+
+/**
+ * Finds the column runs of the table: vertical runs of at least COLUMN_RUN_MIN_ROWS cells
+ * sharing a formula template. The runs whose template matches table_match_linear are linear
+ * runs if their terms and coefficients read no cell of the run, the others are batches if
+ * their formulas read no cell of the run. Compiles the formulas, the terms and the coefficients.
+ *
+ * @param graph Pointer to the graph with the edges filled.
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode.
+ */
+void dep_graph_find_runs(Dep_Graph *graph, Table *table, Expr_Buffer *eb, Bytecode *bc)
+{
+    size_t runs_capacity = 0;
+
+    for(size_t col = 0; col < table->cols; ++col) {
+        size_t row = 0;
+        while(row < table->rows) {
+            size_t head = row * table->cols + col;
+            if(table_kind(table, head) != CELL_KIND_EXPR) {
+                row += 1;
+                continue;
+            }
+
+            Column_Run run = { .col = col, .row_begin = row, .row_end = row + 1 };
+            Expr_Index coef = 0;
+            Expr_Index term = 0;
+            run.kind = table_match_linear(table, eb, head, &run, &coef, &term) ? RUN_KIND_LINEAR : RUN_KIND_BATCH;
+
+            // Clones of the head share its template, the offsets still have to put prev right above
+            Expr_Index root = table_formula(table, head)->index;
+            while(run.row_end < table->rows) {
+                size_t i = run.row_end * table->cols + col;
+                if(table_kind(table, i) != CELL_KIND_EXPR || table_formula(table, i)->index != root) break;
+                if(run.kind == RUN_KIND_LINEAR) {
+                    Column_Run next = run;
+                    Expr_Index next_coef = 0;
+                    Expr_Index next_term = 0;
+                    if(!table_match_linear(table, eb, i, &next, &next_coef, &next_term)) break;
+                    if(next.affine != run.affine || next.term_on_left != run.term_on_left || next.coef_on_left != run.coef_on_left) break;
+                }
+                run.row_end += 1;
+            }
+            row = run.row_end;
+
+            if(run.row_end - run.row_begin < COLUMN_RUN_MIN_ROWS) continue;
+            // A text seed is a #VALUE! error to the first cell, not a number to scan from
+            if(run.kind == RUN_KIND_LINEAR && table_kind(table, head - table->cols) == CELL_KIND_TEXT) continue;
+
+            // The only cell of the run a linear formula may read is the previous one, through prev
+            bool independent = true;
+            for(size_t r = run.row_begin; r < run.row_end && independent; ++r) {
+                size_t i = r * table->cols + col;
+                size_t prevs = 0;
+                for(size_t k = graph->deps_start[i]; k < graph->deps_start[i + 1]; ++k) {
+                    size_t dep = graph->deps[k];
+                    if(dep % table->cols != col || dep / table->cols < run.row_begin || dep / table->cols >= run.row_end) continue;
+                    if(run.kind == RUN_KIND_BATCH || dep + table->cols != i || ++prevs > 1) independent = false;
+                }
+            }
+            if(!independent) continue;
+
+            run.formula = *bytecode_program(bc, eb, root);
+            run.type = expr_buffer_at(eb, root)->type;
+            if(run.kind == RUN_KIND_LINEAR) {
+                run.term = *bytecode_program(bc, eb, term);
+                if(run.affine) {
+                    run.coef = *bytecode_program(bc, eb, coef);
+                }
+                run.constant = run.term.cells == 0 && (!run.affine || run.coef.cells == 0);
+                graph->linear_cells += run.row_end - run.row_begin;
+            }
+
+            if(graph->runs_count >= runs_capacity) {
+                runs_capacity = runs_capacity == 0 ? 16 : runs_capacity * 2;
+                graph->runs = realloc(graph->runs, sizeof(*graph->runs) * runs_capacity);
+            }
+            graph->runs[graph->runs_count++] = run;
+            for(size_t r = run.row_begin; r < run.row_end; ++r) {
+                graph->run_by_cell[r * table->cols + col] = graph->runs_count;
+            }
+        }
+    }
+}
+
+/**
+ * Returns the node standing for a cell in the topological order: the first cell of its
+ * column run, or the cell itself when it belongs to none.
+ *
+ * @param graph Pointer to the dependency graph.
+ * @param cols Number of columns of the table.
+ * @param cell Row-major index of the cell.
+ * @return Row-major index of the node.
+ */
+size_t dep_graph_node(const Dep_Graph *graph, size_t cols, size_t cell)
+{
+    size_t run = graph->run_by_cell[cell];
+    if(run == 0) return cell;
+    return graph->runs[run - 1].row_begin * cols + graph->runs[run - 1].col;
+}
+
+/**
+ * Checks whether two cells belong to the same column run.
+ *
+ * @param graph Pointer to the dependency graph.
+ * @param a Row-major index of the first cell.
+ * @param b Row-major index of the second cell.
+ * @return true if both of the cells are in the same run.
+ */
+bool dep_graph_same_run(const Dep_Graph *graph, size_t a, size_t b)
+{
+    return graph->run_by_cell[a] != 0 && graph->run_by_cell[a] == graph->run_by_cell[b];
+}
+
+/**
+ * Orders the expression cells topologically with Kahn's algorithm. A column run is a single
+ * node, ready once every dependency of its cells from outside of the run is, and its cells
+ * are ordered together from the top. The nodes without dependencies are queued in row-major order.
+ *
+ * @param graph Pointer to the graph with the edges and the runs filled.
+ * @param table Pointer to the table structure.
+ * @param pending Scratch array of cells_count elements, left with the number of unordered dependencies of every node.
+ */
+void dep_graph_order(Dep_Graph *graph, const Table *table, size_t *pending)
+{
+    size_t cols = table->cols;
+    size_t *queue = malloc(sizeof(*queue) * (graph->cells_count + 1));
+    size_t queue_count = 0;
+
+    memset(pending, 0, sizeof(*pending) * graph->cells_count);
+    for(size_t i = 0; i < graph->cells_count; ++i) {
+        for(size_t k = graph->deps_start[i]; k < graph->deps_start[i + 1]; ++k) {
+            if(dep_graph_same_run(graph, i, graph->deps[k])) continue;
+            pending[dep_graph_node(graph, cols, i)] += 1;
+        }
+    }
+    for(size_t i = 0; i < graph->cells_count; ++i) {
+        if(table_kind(table, i) == CELL_KIND_EXPR && dep_graph_node(graph, cols, i) == i && pending[i] == 0) {
+            queue[queue_count++] = i;
+        }
+    }
+
+    graph->order_count = 0;
+    for(size_t head = 0; head < queue_count; ++head) {
+        size_t node = queue[head];
+        size_t run = graph->run_by_cell[node];
+        size_t count = run == 0 ? 1 : graph->runs[run - 1].row_end - graph->runs[run - 1].row_begin;
+
+        for(size_t r = 0; r < count; ++r) {
+            size_t i = node + r * cols;
+            graph->order[graph->order_count++] = i;
+            for(size_t k = graph->users_start[i]; k < graph->users_start[i + 1]; ++k) {
+                size_t user = graph->users[k];
+                if(dep_graph_same_run(graph, i, user)) continue;
+                user = dep_graph_node(graph, cols, user);
+                if(--pending[user] == 0) {
+                    queue[queue_count++] = user;
+                }
+            }
+        }
+    }
+
+    free(queue);
+}
+
+/**
+ * Reports every circular dependency of the graph with all the cells taking part in it
+ * and turns the cells into #CYCLE! errors, see table_report_cycle. The cycles are the
+ * strongly connected components of the cells left out of the topological order, found
+ * with Tarjan's algorithm in linear time. The cells that only depend on a cycle are
+ * not reported, they get the error when they are evaluated.
+ *
+ * @param graph Pointer to the graph ordered without column runs.
+ * @param table Pointer to the table structure.
+ * @param pending Number of the dependencies left unordered for every cell.
+ * @return The number of the reported cycles.
+ */
+size_t dep_graph_report_cycles(const Dep_Graph *graph, Table *table, const size_t *pending)
+{
+    size_t cells_count = graph->cells_count;
+    size_t *index = malloc(sizeof(*index) * (cells_count + 1));
+    size_t *lowlink = malloc(sizeof(*lowlink) * (cells_count + 1));
+    bool *on_stack = calloc(cells_count + 1, sizeof(*on_stack));
+    size_t *stack = malloc(sizeof(*stack) * (cells_count + 1));
+    size_t stack_count = 0;
+    size_t *calls = malloc(sizeof(*calls) * (cells_count + 1));      // Cells of the depth first search
+    size_t *call_edges = malloc(sizeof(*call_edges) * (cells_count + 1)); // Next dependency of every cell of it
+    size_t calls_count = 0;
+
+    // The cycles in the order of their first cells, scc_by_first[i] is the index of the cycle starting at i
+    size_t *members = malloc(sizeof(*members) * (cells_count + 1));
+    size_t members_count = 0;
+    size_t *sccs_start = malloc(sizeof(*sccs_start) * (cells_count + 1));
+    size_t sccs_count = 0;
+    size_t *scc_by_first = malloc(sizeof(*scc_by_first) * (cells_count + 1));
+
+    for(size_t i = 0; i < cells_count; ++i) {
+        index[i] = SIZE_MAX;
+        scc_by_first[i] = SIZE_MAX;
+    }
+
+    size_t next_index = 0;
+    for(size_t root = 0; root < cells_count; ++root) {
+        if(table_kind(table, root) != CELL_KIND_EXPR || pending[root] == 0 || index[root] != SIZE_MAX) continue;
+
+        index[root] = lowlink[root] = next_index++;
+        stack[stack_count++] = root;
+        on_stack[root] = true;
+        calls[calls_count] = root;
+        call_edges[calls_count++] = graph->deps_start[root];
+
+        while(calls_count > 0) {
+            size_t v = calls[calls_count - 1];
+            if(call_edges[calls_count - 1] < graph->deps_start[v + 1]) {
+                size_t w = graph->deps[call_edges[calls_count - 1]++];
+                if(pending[w] == 0) continue; // Ordered, so on no cycle
+
+                if(index[w] == SIZE_MAX) {
+                    index[w] = lowlink[w] = next_index++;
+                    stack[stack_count++] = w;
+                    on_stack[w] = true;
+                    calls[calls_count] = w;
+                    call_edges[calls_count++] = graph->deps_start[w];
+                } else if(on_stack[w] && index[w] < lowlink[v]) {
+                    lowlink[v] = index[w];
+                }
+                continue;
+            }
+
+            calls_count -= 1;
+            if(calls_count > 0 && lowlink[v] < lowlink[calls[calls_count - 1]]) {
+                lowlink[calls[calls_count - 1]] = lowlink[v];
+            }
+            if(lowlink[v] != index[v]) continue;
+
+            // v is the root of a strongly connected component
+            size_t begin = members_count;
+            size_t first = v;
+            size_t w = 0;
+            do {
+                w = stack[--stack_count];
+                on_stack[w] = false;
+                members[members_count++] = w;
+                if(first > w) first = w;
+            } while(w != v);
+
+            bool cycle = members_count - begin > 1;
+            for(size_t k = graph->deps_start[v]; !cycle && k < graph->deps_start[v + 1]; ++k) {
+                cycle = graph->deps[k] == v;
+            }
+            if(!cycle) {
+                members_count = begin;
+                continue;
+            }
+
+            scc_by_first[first] = sccs_count;
+            sccs_start[sccs_count++] = begin;
+        }
+    }
+    sccs_start[sccs_count] = members_count;
+
+    for(size_t i = 0; i < cells_count; ++i) {
+        size_t scc = scc_by_first[i];
+        if(scc == SIZE_MAX) continue;
+        table_report_cycle(table, members + sccs_start[scc], sccs_start[scc + 1] - sccs_start[scc]);
+    }
+
+    free(index);
+    free(lowlink);
+    free(on_stack);
+    free(stack);
+    free(calls);
+    free(call_edges);
+    free(members);
+    free(sccs_start);
+    free(scc_by_first);
+    return sccs_count;
+}
+
+/**
+ * Releases all the memory owned by the dependency graph.
+ *
+ * @param graph Pointer to the graph.
+ */
+void dep_graph_free(Dep_Graph *graph)
+{
+    free(graph->deps_start);
+    free(graph->deps);
+    free(graph->users_start);
+    free(graph->users);
+    free(graph->order);
+    free(graph->runs);
+    free(graph->run_by_cell);
+    memset(graph, 0, sizeof(*graph));
+}
+
+/**
+ * Builds the dependency graph of a table with resolved clones and orders its expression
+ * cells topologically with Kahn's algorithm. Turns the cells of circular dependencies into
+ * #CYCLE! errors, see dep_graph_report_cycles.
+ *
+ * @param graph Pointer to the graph to build.
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode.
+ */
+void dep_graph_build(Dep_Graph *graph, Table *table, Expr_Buffer *eb, Bytecode *bc)
+{
+    size_t cells_count = table->rows * table->cols;
+    memset(graph, 0, sizeof(*graph));
+    graph->cells_count = cells_count;
+    graph->deps_start = calloc(cells_count + 1, sizeof(*graph->deps_start));
+    graph->users_start = calloc(cells_count + 1, sizeof(*graph->users_start));
+
+    size_t *deps = NULL;
+    size_t deps_capacity = 0;
+
+    // Count the dependencies and the users of every cell
+    size_t exprs_count = 0;
+    for(size_t i = 0; i < cells_count; ++i) {
+        assert(table_kind(table, i) != CELL_KIND_CLONE);
+        if(table_kind(table, i) != CELL_KIND_EXPR) continue;
+
+        exprs_count += 1;
+        size_t count = table_formula_deps(table, eb, bc, i, &deps, &deps_capacity);
+        for(size_t k = 0; k < count; ++k) {
+            if(table_kind(table, deps[k]) != CELL_KIND_EXPR) continue;
+            graph->deps_start[i + 1] += 1;
+            graph->users_start[deps[k] + 1] += 1;
+        }
+    }
+
+    for(size_t i = 0; i < cells_count; ++i) {
+        graph->deps_start[i + 1] += graph->deps_start[i];
+        graph->users_start[i + 1] += graph->users_start[i];
+    }
+
+    size_t edges_count = graph->deps_start[cells_count];
+    graph->deps = malloc(sizeof(*graph->deps) * (edges_count + 1));
+    graph->users = malloc(sizeof(*graph->users) * (edges_count + 1));
+    graph->order = malloc(sizeof(*graph->order) * (exprs_count + 1));
+
+    // Fill the edges in both directions, users_fill[i] is the next free slot of the users of i
+    size_t *users_fill = malloc(sizeof(*users_fill) * (cells_count + 1));
+    memcpy(users_fill, graph->users_start, sizeof(*users_fill) * (cells_count + 1));
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(table_kind(table, i) != CELL_KIND_EXPR) continue;
+
+        size_t deps_fill = graph->deps_start[i];
+        size_t count = table_formula_deps(table, eb, bc, i, &deps, &deps_capacity);
+        for(size_t k = 0; k < count; ++k) {
+            if(table_kind(table, deps[k]) != CELL_KIND_EXPR) continue;
+            graph->deps[deps_fill++] = deps[k];
+            graph->users[users_fill[deps[k]]++] = i;
+        }
+    }
+
+    graph->run_by_cell = calloc(cells_count + 1, sizeof(*graph->run_by_cell));
+    dep_graph_find_runs(graph, table, eb, bc);
+
+    size_t *pending = users_fill;
+    dep_graph_order(graph, table, pending);
+    if(graph->order_count < exprs_count && graph->runs_count > 0) {
+        // Merging a run into one node may close a cycle through the cells its terms
+        // read, order the cells one by one instead
+        free(graph->runs);
+        graph->runs = NULL;
+        graph->runs_count = 0;
+        graph->linear_cells = 0;
+        memset(graph->run_by_cell, 0, sizeof(*graph->run_by_cell) * cells_count);
+        dep_graph_order(graph, table, pending);
+    }
+
+    bool cycles = graph->order_count < exprs_count;
+    if(cycles) {
+        size_t reported = dep_graph_report_cycles(graph, table, pending);
+        assert(reported > 0);
+        (void) reported;
+    }
+
+    free(users_fill);
+    free(deps);
+
+    if(cycles) {
+        // The cells of the cycles are #CYCLE! errors now, order the rest of the table
+        dep_graph_free(graph);
+        dep_graph_build(graph, table, eb, bc);
+    }
+}
+
+/**
+ * Reports every circular dependency among the cells not evaluated yet that the given cells
+ * depend on, and turns the cells of the cycles into #CYCLE! errors, see dep_graph_report_cycles.
+ * Evaluating the cells on demand afterwards gives them the values of a full run and, since the
+ * cycles are reported together in the order of their first cells, the same warnings whatever
+ * the order of the given cells.
+ *
+ * @param table Pointer to the table structure with resolved clones.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode.
+ * @param cells Row-major indices of the cells.
+ * @param count Number of the cells.
+ */
+void table_report_cone_cycles(Table *table, Expr_Buffer *eb, Bytecode *bc, const size_t *cells, size_t count)
+{
+    size_t cells_count = table->rows * table->cols;
+    Dep_Graph graph = { .cells_count = cells_count };
+    graph.deps_start = calloc(cells_count + 1, sizeof(*graph.deps_start));
+
+    // The cone of the cells, found breadth first. Only its cells are candidates
+    // for the cycles, marked as if they were left out of a topological order.
+    size_t *pending = calloc(cells_count + 1, sizeof(*pending));
+    size_t *cone = calloc(cells_count + 1, sizeof(*cone));
+    if(graph.deps_start == NULL || pending == NULL || cone == NULL) {
+        fprintf(stderr, "ERROR: could not allocate the dependency graph of the evaluated cells\n");
+        exit(1);
+    }
+    size_t cone_count = 0;
+    size_t *deps = NULL;
+    size_t deps_capacity = 0;
+
+    for(size_t k = 0; k < count; ++k) {
+        size_t cell = cells[k];
+        if(table_kind(table, cell) != CELL_KIND_EXPR || table_evaluated(table, cell) || pending[cell] != 0) continue;
+        pending[cell] = 1;
+        cone[cone_count++] = cell;
+    }
+    for(size_t head = 0; head < cone_count; ++head) {
+        size_t cell = cone[head];
+        size_t deps_count = table_formula_deps(table, eb, bc, cell, &deps, &deps_capacity);
+        for(size_t k = 0; k < deps_count; ++k) {
+            size_t dep = deps[k];
+            if(table_kind(table, dep) != CELL_KIND_EXPR || table_evaluated(table, dep)) continue;
+            graph.deps_start[cell + 1] += 1;
+            if(pending[dep] != 0) continue;
+            pending[dep] = 1;
+            cone[cone_count++] = dep;
+        }
+    }
+
+    for(size_t i = 0; i < cells_count; ++i) {
+        graph.deps_start[i + 1] += graph.deps_start[i];
+    }
+    graph.deps = malloc(sizeof(*graph.deps) * (graph.deps_start[cells_count] + 1));
+    if(graph.deps == NULL) {
+        fprintf(stderr, "ERROR: could not allocate the dependency graph of the evaluated cells\n");
+        exit(1);
+    }
+    for(size_t head = 0; head < cone_count; ++head) {
+        size_t cell = cone[head];
+        size_t deps_fill = graph.deps_start[cell];
+        size_t deps_count = table_formula_deps(table, eb, bc, cell, &deps, &deps_capacity);
+        for(size_t k = 0; k < deps_count; ++k) {
+            if(table_kind(table, deps[k]) != CELL_KIND_EXPR || table_evaluated(table, deps[k])) continue;
+            graph.deps[deps_fill++] = deps[k];
+        }
+    }
+
+    dep_graph_report_cycles(&graph, table, pending);
+
+    dep_graph_free(&graph);
+    free(pending);
+    free(cone);
+    free(deps);
+}
+
+// Evaluated state of a table saved for incremental recalculation. The file consists of
+// a header, the hash of every row of the input, the value of every cell and the reverse
+// dependency index of the table in compressed sparse row form. Unlike the users of the
+// dependency graph, the index covers the users of number and text cells too, since a new
+// input or a patch may change any cell.
+#define STATE_MAGIC "EXCLSTAT"
+#define STATE_VERSION 2
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t cell_size;   // sizeof(State_Cell) of the writer
+    uint32_t word_size;   // sizeof(size_t) of the writer
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t users_count;
+} State_Header;
+
+// Value of an evaluated cell, meaningful for expression cells only
+typedef struct {
+    Value_Type type;
+    union {
+        double number;
+        int64_t integer;
+    };
+} State_Cell;
+
+// A state file loaded into memory
+typedef struct {
+    char *data;
+    const uint64_t *row_hashes; // Hashes of the rows of the input the state was evaluated from
+    const State_Cell *cells;
+    const size_t *users_start; // Users of the cell i are users[users_start[i]..users_start[i + 1]]
+    const size_t *users;       // Expression cells reading a cell
+} State;
+
+/**
+ * Saves the evaluated table together with its reverse dependency index.
+ * Failure to write the state is reported but not fatal.
+ *
+ * @param state_path Path to the state file.
+ * @param table Pointer to the evaluated table.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode.
+ * @param content Content of the input the table was parsed from.
+ */
+void state_save(const char *state_path, Table *table, Expr_Buffer *eb, Bytecode *bc, String_View content)
+{
+    size_t cells_count = table->rows * table->cols;
+    size_t *users_start = calloc(cells_count + 1, sizeof(*users_start));
+    if(users_start == NULL) {
+        fprintf(stderr, "ERROR: could not allocate the reverse index of the dependencies\n");
+        exit(1);
+    }
+    size_t *deps = NULL;
+    size_t deps_capacity = 0;
+
+    // Count the users of every cell
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(table_kind(table, i) != CELL_KIND_EXPR) continue;
+        size_t count = table_formula_deps(table, eb, bc, i, &deps, &deps_capacity);
+        for(size_t k = 0; k < count; ++k) users_start[deps[k] + 1] += 1;
+    }
+    for(size_t i = 0; i < cells_count; ++i) {
+        users_start[i + 1] += users_start[i];
+    }
+
+    // Fill the users, users_fill[i] is the next free slot of the users of i
+    size_t users_count = users_start[cells_count];
+    size_t *users = malloc(sizeof(*users) * (users_count + 1));
+    size_t *users_fill = malloc(sizeof(*users_fill) * (cells_count + 1));
+    if(users == NULL || users_fill == NULL) {
+        fprintf(stderr, "ERROR: could not allocate the reverse index of the dependencies\n");
+        exit(1);
+    }
+    memcpy(users_fill, users_start, sizeof(*users_fill) * (cells_count + 1));
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(table_kind(table, i) != CELL_KIND_EXPR) continue;
+        size_t count = table_formula_deps(table, eb, bc, i, &deps, &deps_capacity);
+        for(size_t k = 0; k < count; ++k) users[users_fill[deps[k]]++] = i;
+    }
+    free(users_fill);
+
+    FILE *stream = fopen(state_path, "wb");
+    if(stream == NULL) {
+        fprintf(stderr, "WARNING: could not write state file %s: %s\n", state_path, strerror(errno));
+        goto defer;
+    }
+
+    State_Header header = {
+        .version = STATE_VERSION,
+        .cell_size = sizeof(State_Cell),
+        .word_size = sizeof(size_t),
+        .rows = table->rows,
+        .cols = table->cols,
+        .users_count = users_count,
+    };
+    memcpy(header.magic, STATE_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(header), 1, stream);
+
+    for(size_t row = 0; row < table->rows; ++row) {
+        uint64_t hash = input_hash(sv_chop_by_delim(&content, '\n'));
+        fwrite(&hash, sizeof(hash), 1, stream);
+    }
+
+    for(size_t i = 0; i < cells_count; ++i) {
+        State_Cell state_cell = {0};
+        if(table_kind(table, i) == CELL_KIND_EXPR || table_kind(table, i) == CELL_KIND_NUMBER) {
+            state_cell.type = table_type(table, i);
+            state_cell.integer = table_value(table, i).integer;
+        }
+        fwrite(&state_cell, sizeof(state_cell), 1, stream);
+    }
+    fwrite(users_start, sizeof(*users_start), cells_count + 1, stream);
+    fwrite(users, sizeof(*users), users_count, stream);
+
+    if(ferror(stream)) {
+        fprintf(stderr, "WARNING: could not write state file %s: %s\n", state_path, strerror(errno));
+    }
+    fclose(stream);
+
+defer:
+    free(users_start);
+    free(users);
+    free(deps);
+}
+
+/**
+ * Releases the memory of a loaded state.
+ *
+ * @param state Pointer to the state.
+ */
+void state_free(State *state)
+{
+    free(state->data);
+    memset(state, 0, sizeof(*state));
+}
+
+/**
+ * Loads the state saved by a previous run over an input of the same size.
+ * A missing state file is not an error: the first run has none.
+ *
+ * @param state Pointer to the state to fill.
+ * @param state_path Path to the state file.
+ * @param table Pointer to the parsed table.
+ * @return true if the state fits the table and was loaded, false otherwise.
+ */
+bool state_load(State *state, const char *state_path, const Table *table)
+{
+    size_t size = 0;
+    state->data = read_csv(state_path, &size);
+    if(state->data == NULL) return false;
+
+    State_Header header = {0};
+    if(size >= sizeof(header)) memcpy(&header, state->data, sizeof(header));
+
+    size_t cells_count = table->rows * table->cols;
+    uint64_t expected_size = sizeof(header) + table->rows * sizeof(uint64_t) + cells_count * sizeof(State_Cell)
+        + (cells_count + 1 + header.users_count) * sizeof(size_t);
+    if(size < sizeof(header) ||
+       memcmp(header.magic, STATE_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != STATE_VERSION ||
+       header.cell_size != sizeof(State_Cell) ||
+       header.word_size != sizeof(size_t) ||
+       header.rows != table->rows ||
+       header.cols != table->cols ||
+       expected_size != size) {
+        fprintf(stderr, "WARNING: state file %s does not match the size of the table, evaluating every cell\n", state_path);
+        state_free(state);
+        return false;
+    }
+
+    state->row_hashes = (const uint64_t *) (state->data + sizeof(header));
+    state->cells = (const State_Cell *) (state->row_hashes + table->rows);
+    state->users_start = (const size_t *) (state->cells + cells_count);
+    state->users = state->users_start + cells_count + 1;
+    return true;
+}
+
+/**
+ * Marks every cell of the rows of the input that changed since the state was saved.
+ *
+ * @param table Pointer to the parsed table.
+ * @param state Pointer to the state of the previous run.
+ * @param content Content of the input.
+ * @param dirty Array to mark the changed cells in.
+ * @return The number of the changed rows.
+ */
+size_t table_diff_rows(const Table *table, const State *state, String_View content, bool *dirty)
+{
+    size_t changed = 0;
+    for(size_t row = 0; row < table->rows; ++row) {
+        if(input_hash(sv_chop_by_delim(&content, '\n')) == state->row_hashes[row]) continue;
+        for(size_t col = 0; col < table->cols; ++col) {
+            dirty[row * table->cols + col] = true;
+        }
+        changed += 1;
+    }
+    return changed;
+}
+
+/**
+ * Checks that a comma separated list of the command line has no empty items,
+ * like in `A,,B` or `A,`, and is not empty itself.
+ *
+ * @param what What the list holds, for the error message.
+ * @param list The list.
+ */
+void check_list_items(const char *what, const char *list)
+{
+    if(sv_trim(sv_from_cstr(list)).count == 0) {
+        fprintf(stderr, "ERROR: the list of %s is empty\n", what);
+        exit(1);
+    }
+
+    const char *item = list;
+    while(true) {
+        const char *comma = strchr(item, ',');
+        String_View trimmed = sv_trim(sv_from_parts(item, comma ? (size_t) (comma - item) : strlen(item)));
+        if(trimmed.count == 0) {
+            fprintf(stderr, "ERROR: the list of %s \"%s\" has an empty item\n", what, list);
+            exit(1);
+        }
+        if(comma == NULL) break;
+        item = comma + 1;
+    }
+}
+
+/**
+ * Parses the name of a cell, like A0 or D12: the column letter followed by the row number.
+ *
+ * @param name The name of the cell.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param out Pointer to store the index of the cell.
+ * @return true if the name is correct, false otherwise.
+ */
+bool parse_cell_name(String_View name, Tmp_Cstr *tc, Cell_Index *out)
+{
+    if(name.count < 2 || !isupper(*name.data)) return false;
+    out->col = *name.data - 'A';
+    sv_chop_left(&name, 1);
+
+    long int row = 0;
+    if(!isdigit(*name.data) || !sv_strtol(name, tc, &row)) return false;
+    out->row = (size_t) row;
+    return true;
+}
+
+// Rectangle of cells between two corners, inclusive
+typedef struct {
+    Cell_Index first;
+    Cell_Index last;
+} Cell_Range;
+
+/**
+ * Parses a comma separated list of cells and ranges of cells, like `E6,D2:D10`.
+ * Reports empty items, names that are not correct and cells outside of the table.
+ *
+ * @param table Pointer to the table structure.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param list The list of cells.
+ * @param ranges_count Pointer to store the number of the ranges.
+ * @return Newly allocated array of the ranges, in the order of the list.
+ */
+Cell_Range *table_parse_ranges(const Table *table, Tmp_Cstr *tc, const char *list, size_t *ranges_count)
+{
+    check_list_items("cells", list);
+    Cell_Range *ranges = NULL;
+    size_t ranges_capacity = 0;
+    *ranges_count = 0;
+
+    String_View rest = sv_from_cstr(list);
+    while(rest.count > 0) {
+        String_View item = sv_trim(sv_chop_by_delim(&rest, ','));
+        String_View last = item;
+        String_View first = sv_trim(sv_chop_by_delim(&last, ':'));
+        last = sv_trim(last);
+
+        bool is_range = memchr(item.data, ':', item.count) != NULL;
+        Cell_Range range = {0};
+        if(!parse_cell_name(first, tc, &range.first) ||
+           !parse_cell_name(is_range ? last : first, tc, &range.last)) {
+            fprintf(stderr, "ERROR: "SV_Fmt" is not a correct cell or range of cells\n", SV_Arg(item));
+            exit(1);
+        }
+        if(range.first.row >= table->rows || range.first.col >= table->cols ||
+           range.last.row >= table->rows || range.last.col >= table->cols) {
+            fprintf(stderr, "ERROR: "SV_Fmt" is outside of the table\n", SV_Arg(item));
+            exit(1);
+        }
+
+        if(range.first.row > range.last.row) {
+            size_t row = range.first.row;
+            range.first.row = range.last.row;
+            range.last.row = row;
+        }
+        if(range.first.col > range.last.col) {
+            size_t col = range.first.col;
+            range.first.col = range.last.col;
+            range.last.col = col;
+        }
+
+        if(*ranges_count >= ranges_capacity) {
+            ranges_capacity = ranges_capacity == 0 ? 16 : ranges_capacity * 2;
+            ranges = realloc(ranges, sizeof(*ranges) * ranges_capacity);
+        }
+        ranges[(*ranges_count)++] = range;
+    }
+
+    return ranges;
+}
+
+/**
+ * Parses a comma separated list of columns and ranges of columns, like `A,C:E`.
+ * Reports empty items and letters that are not columns of the table.
+ *
+ * @param table Pointer to the table structure.
+ * @param list The list of columns.
+ * @param shown Array to mark the listed columns in.
+ */
+void table_parse_columns(const Table *table, const char *list, bool *shown)
+{
+    check_list_items("columns", list);
+    String_View rest = sv_from_cstr(list);
+    while(rest.count > 0) {
+        String_View item = sv_trim(sv_chop_by_delim(&rest, ','));
+        String_View last = item;
+        String_View first = sv_trim(sv_chop_by_delim(&last, ':'));
+        last = sv_trim(last);
+        if(memchr(item.data, ':', item.count) == NULL) last = first;
+
+        if(first.count != 1 || last.count != 1 || !isupper(*first.data) || !isupper(*last.data)) {
+            fprintf(stderr, "ERROR: "SV_Fmt" is not a correct column or range of columns\n", SV_Arg(item));
+            exit(1);
+        }
+
+        size_t first_col = *first.data - 'A';
+        size_t last_col = *last.data - 'A';
+        if(first_col > last_col) {
+            size_t col = first_col;
+            first_col = last_col;
+            last_col = col;
+        }
+        if(last_col >= table->cols) {
+            fprintf(stderr, "ERROR: "SV_Fmt" is outside of the table\n", SV_Arg(item));
+            exit(1);
+        }
+
+        for(size_t col = first_col; col <= last_col; ++col) {
+            shown[col] = true;
+        }
     }
+}
 
-    memcpy(tc->cstr, data, data_size);
-    tc->cstr[data_size] = '\0';
-    return tc->cstr;
+/**
+ * Blanks every column that no formula of the shown columns needs, directly or
+ * through other columns, so that no evaluation sees them. The needed columns are
+ * found by a static scan of the cell references of the formulas, which are shifted
+ * by the offsets of the cells but not resolved, so nothing is reported here.
+ *
+ * @param table Pointer to the table structure with resolved clones.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode.
+ * @param shown The columns to render.
+ */
+void table_project_columns(Table *table, Expr_Buffer *eb, Bytecode *bc, const bool *shown)
+{
+    bool *needed = malloc(sizeof(*needed) * (table->cols + 1));
+    size_t *queue = malloc(sizeof(*queue) * (table->cols + 1));
+    size_t queue_count = 0;
+    for(size_t col = 0; col < table->cols; ++col) {
+        needed[col] = shown[col];
+        if(needed[col]) queue[queue_count++] = col;
+    }
+
+    for(size_t head = 0; head < queue_count; ++head) {
+        size_t col = queue[head];
+        for(size_t row = 0; row < table->rows; ++row) {
+            size_t cell = row * table->cols + col;
+            if(table_kind(table, cell) != CELL_KIND_EXPR) continue;
+
+            const Program *program = bytecode_program(bc, eb, table_formula(table, cell)->index);
+            for(size_t pc = program->start;; ++pc) {
+                const Inst *inst = &bc->items[pc];
+                for(size_t k = 0; k < 2; ++k) {
+                    if(inst_operand_kinds[inst->kind][k] != OPERAND_CELL) continue;
+
+                    Cell_Index ref = k == 0 ? inst->a.cell : inst->b.cell;
+                    ptrdiff_t dep = (ptrdiff_t) ref.col + table_formula(table, cell)->offset.col;
+                    if(dep < 0 || (size_t) dep >= table->cols || needed[dep]) continue;
+                    needed[dep] = true;
+                    queue[queue_count++] = (size_t) dep;
+                }
+                if(inst->kind == INST_RET) break;
+            }
+        }
+    }
+
+    for(size_t col = 0; col < table->cols; ++col) {
+        if(needed[col]) continue;
+        for(size_t row = 0; row < table->rows; ++row) {
+            size_t cell = row * table->cols + col;
+            table_set_text(table, cell, SV(""));
+        }
+    }
+
+    free(needed);
+    free(queue);
+}
+
+/**
+ * Applies a patch to the parsed table. Every line of the patch sets a cell to a new
+ * value written the same way as in the input, like `A1=5`, `B2==A1+1` or `C3=:^`.
+ * Empty lines are skipped.
+ *
+ * @param table Pointer to the parsed table.
+ * @param eb Pointer to the expression buffer.
+ * @param tc Pointer to a temporary C-string structure.
+ * @param patch_path Path to the patch file, for error reporting.
+ * @param patch Content of the patch, the text cells point into it.
+ * @param dirty Array to mark the patched cells in.
+ */
+void table_apply_patch(Table *table, Expr_Buffer *eb, Tmp_Cstr *tc, const char *patch_path, String_View patch, bool *dirty)
+{
+    for(size_t file_row = 1; patch.count > 0; ++file_row) {
+        String_View line = sv_chop_by_delim(&patch, '\n');
+        const char *const line_start = line.data;
+        String_View entry = sv_trim(line);
+        if(entry.count == 0) continue;
+
+        size_t file_col = entry.data - line_start + 1;
+        if(memchr(entry.data, '=', entry.count) == NULL) {
+            fprintf(stderr, "%s:%zu:%zu: ERROR: expected a cell assignment like A1=value\n", patch_path, file_row, file_col);
+            exit(1);
+        }
+
+        String_View name = sv_trim(sv_chop_by_delim(&entry, '='));
+        Cell_Index index = {0};
+        if(!parse_cell_name(name, tc, &index)) {
+            fprintf(stderr, "%s:%zu:%zu: ERROR: "SV_Fmt" is not a correct cell name\n", patch_path, file_row, file_col, SV_Arg(name));
+            exit(1);
+        }
+        if(index.row >= table->rows || index.col >= table->cols) {
+            fprintf(stderr, "%s:%zu:%zu: ERROR: cell "SV_Fmt" is outside of the table\n", patch_path, file_row, file_col, SV_Arg(name));
+            exit(1);
+        }
+
+        // The new value is parsed at its place in the patch, errors of the evaluation
+        // are reported at the place of the cell in the input
+        size_t cell = table_cell_at(table, index);
+        parse_cell(table, cell, eb, tc, sv_trim(entry), patch_path, file_row, line_start);
+
+        dirty[cell] = true;
+    }
+}
+
+/**
+ * Marks the clones that copy a changed cell, directly or through other clones.
+ * Chains of clones leaving the table or going around in a cycle are left to
+ * table_resolve_clones to turn into errors.
+ *
+ * @param table Pointer to the changed table with unresolved clones.
+ * @param dirty Array with the changed cells marked.
+ */
+void table_mark_dirty_clones(const Table *table, bool *dirty)
+{
+    size_t cells_count = table->rows * table->cols;
+    bool *seen = calloc(cells_count + 1, sizeof(*seen));
+    if(seen == NULL) {
+        fprintf(stderr, "ERROR: could not allocate the changed cells\n");
+        exit(1);
+    }
+    size_t *chain = NULL;
+    size_t chain_count = 0;
+    size_t chain_capacity = 0;
+
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(seen[i] || dirty[i] || table_kind(table, i) != CELL_KIND_CLONE) continue;
+
+        // Follow the chain until it reaches a cell whose state is known
+        Cell_Index index = { .row = i / table->cols, .col = i % table->cols };
+        size_t cell = i;
+        bool changed = false;
+        chain_count = 0;
+        for(;;) {
+            seen[cell] = true;
+            if(chain_count >= chain_capacity) {
+                chain_capacity = chain_capacity == 0 ? 64 : chain_capacity * 2;
+                chain = realloc(chain, sizeof(*chain) * chain_capacity);
+                if(chain == NULL) {
+                    fprintf(stderr, "ERROR: could not allocate the changed cells\n");
+                    exit(1);
+                }
+            }
+            chain[chain_count++] = cell;
+
+            index = nbor_in_dir(index, table_clone(table, cell));
+            if(index.row >= table->rows || index.col >= table->cols) break;
+            cell = index.row * table->cols + index.col;
+            if(seen[cell] || dirty[cell] || table_kind(table, cell) != CELL_KIND_CLONE) {
+                changed = dirty[cell];
+                break;
+            }
+        }
+
+        while(chain_count > 0) {
+            dirty[chain[--chain_count]] = changed;
+        }
+    }
+
+    free(seen);
+    free(chain);
+}
+
+/**
+ * Recomputes the cells affected by changes to the input or by a patch. The changed cells
+ * are propagated through the reverse dependency index of the previous run, the cells
+ * outside of the affected cone take their values from the state, and the cone is
+ * evaluated on demand. Every cycle of the table lies within the cone, since the cells
+ * saved as #CYCLE! errors are recomputed, so reporting the cycles of the cone up front
+ * gives the values and the warnings of a full run.
+ *
+ * @param table Pointer to the changed table with resolved clones.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode.
+ * @param state Pointer to the state of the previous run.
+ * @param dirty Array with the changed cells marked, the whole cone is marked on return.
+ * @return The number of the cells in the cone.
+ */
+size_t table_eval_dirty(Table *table, Expr_Buffer *eb, Bytecode *bc, const State *state, bool *dirty)
+{
+    size_t cells_count = table->rows * table->cols;
+    size_t *cone = calloc(cells_count + 1, sizeof(*cone));
+    if(cone == NULL) {
+        fprintf(stderr, "ERROR: could not allocate the changed cells\n");
+        exit(1);
+    }
+    size_t cone_count = 0;
+
+    // The cells of a cycle are saved as #CYCLE! errors without the users of their formulas,
+    // since a change could break the cycle they are recomputed every time
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(table_kind(table, i) == CELL_KIND_EXPR && state->cells[i].type == VALUE_TYPE_DOUBLE
+            && value_error(state->cells[i].number) == ERROR_KIND_CYCLE) {
+            dirty[i] = true;
+        }
+        if(dirty[i]) cone[cone_count++] = i;
+    }
+    for(size_t head = 0; head < cone_count; ++head) {
+        size_t cell = cone[head];
+        for(size_t k = state->users_start[cell]; k < state->users_start[cell + 1]; ++k) {
+            size_t user = state->users[k];
+            if(dirty[user]) continue;
+            dirty[user] = true;
+            cone[cone_count++] = user;
+        }
+    }
+
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(table_kind(table, i) == CELL_KIND_EXPR && !dirty[i]) {
+            table_set_value(table, i, state->cells[i].type, (Cell_Value) { .integer = state->cells[i].integer });
+        }
+    }
+
+    table_report_cone_cycles(table, eb, bc, cone, cone_count);
+    for(size_t k = 0; k < cone_count; ++k) {
+        Cell_Index index = { .row = cone[k] / table->cols, .col = cone[k] % table->cols };
+        table_eval_cell(table, eb, bc, index);
+    }
+
+    free(cone);
+    return cone_count;
+}
+
+// Parallel evaluation needs POSIX threads and C11 atomics, other targets evaluate serially
+#if !defined(_WIN32) && !defined(__STDC_NO_ATOMICS__) && !defined(PARALLEL_DISABLE)
+#define PARALLEL_SUPPORTED
+#endif
+
+/**
+ * Copies the bytecode for a worker thread. The copy shares the compiled formulas,
+ * which must all be compiled already, and has a stack of its own.
+ *
+ * @param bc Pointer to the bytecode.
+ * @return The copy, whose stack is released with free(copy.stack).
+ */
+Bytecode bytecode_worker_copy(const Bytecode *bc)
+{
+    Bytecode copy = *bc;
+    copy.stack = NULL;
+    copy.stack_top = 0;
+    copy.stack_capacity = 0;
+    return copy;
+}
+
+#ifdef PARALLEL_SUPPORTED
+
+/**
+ * Runs a function on the given number of threads and waits for all of them.
+ * The calling thread runs the first one.
+ *
+ * @param jobs Number of threads.
+ * @param run The function.
+ * @param args Array of the arguments of every thread.
+ * @param arg_size Size of an argument in bytes.
+ */
+void parallel_run(size_t jobs, void *(*run)(void *), void *args, size_t arg_size)
+{
+    pthread_t *threads = malloc(sizeof(*threads) * jobs);
+    for(size_t i = 1; i < jobs; ++i) {
+        int error = pthread_create(&threads[i], NULL, run, (char *) args + i * arg_size);
+        if(error != 0) {
+            fprintf(stderr, "ERROR: could not create a thread: %s\n", strerror(error));
+            exit(1);
+        }
+    }
+    run(args);
+    for(size_t i = 1; i < jobs; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
+
+#endif // PARALLEL_SUPPORTED
+
+// Block of rows of a linear run evaluated by one thread
+typedef struct {
+    Table *table;
+    Bytecode *bc;
+    const Column_Run *run;
+    Value_Type type;     // Arithmetic of the rows, the doubles once the seed is a double
+    Vm_Value *coefs;     // Coefficient of every row of the run
+    Vm_Value *terms;     // Term of every row of the run
+
+    size_t row_begin;
+    size_t row_end;
+    size_t terms_end;    // Rows of the block below it have their terms
+    size_t limit;        // Rows of the block below it have their values stored
+    bool exact;          // The composition of the rows is exact
+    Vm_Value scale;      // The rows map the value above the block x to scale*x + shift
+    Vm_Value shift;
+    Vm_Value start;      // Value right above the block
+    Vm_Value end;        // Value of the last row of the block
+} Linear_Block;
+
+/**
+ * Checks whether a double is an integer small enough that every sum and product
+ * of such integers within the same bound is exact.
+ *
+ * @param number The double.
+ * @return true if the number is an integer of at most 2^53 in magnitude.
+ */
+bool linear_exact(double number)
+{
+    return fabs(number) <= 9007199254740992.0 && number == trunc(number);
+}
+
+/**
+ * Computes the value of one row of a linear run from the value above it, exactly
+ * like the virtual machine computes the formula, operand order included.
+ *
+ * @param block Pointer to the block of the row.
+ * @param k Index of the row within the run.
+ * @param prev Value above the row.
+ * @param out Pointer to the value of the row.
+ * @return false if the integer arithmetic overflows.
+ */
+bool linear_step(const Linear_Block *block, size_t k, Vm_Value prev, Vm_Value *out)
+{
+    const Column_Run *run = block->run;
+    Vm_Value coef = block->coefs[k];
+    Vm_Value term = block->terms[k];
+
+    if(block->type == VALUE_TYPE_INT) {
+        int64_t value = prev.integer;
+        if(run->affine) {
+            bool ok = run->coef_on_left ? vm_mul_int(coef.integer, value, &value) : vm_mul_int(value, coef.integer, &value);
+            if(!ok) return false;
+        }
+        return run->term_on_left ? vm_add_int(term.integer, value, &out->integer) : vm_add_int(value, term.integer, &out->integer);
+    }
+
+    double value = prev.number;
+    if(run->affine) {
+        value = run->coef_on_left ? vm_mul(coef.number, value) : vm_mul(value, coef.number);
+    }
+    out->number = run->term_on_left ? vm_add(term.number, value) : vm_add(value, term.number);
+    return true;
+}
+
+/**
+ * Composes the map of a block, x -> scale*x + shift, with one more row of it,
+ * checking that the composition is exact.
+ *
+ * @param block Pointer to the block.
+ * @param k Index of the row within the run.
+ * @return false if the composition overflows or rounds.
+ */
+bool linear_compose(Linear_Block *block, size_t k)
+{
+    Vm_Value coef = block->coefs[k];
+    Vm_Value term = block->terms[k];
+
+    if(block->type == VALUE_TYPE_INT) {
+        if(block->run->affine) {
+            if(!vm_mul_int(coef.integer, block->scale.integer, &block->scale.integer)) return false;
+            if(!vm_mul_int(coef.integer, block->shift.integer, &block->shift.integer)) return false;
+        }
+        return vm_add_int(block->shift.integer, term.integer, &block->shift.integer);
+    }
+
+    if(!linear_exact(term.number)) return false;
+    if(block->run->affine) {
+        if(!linear_exact(coef.number)) return false;
+        block->scale.number *= coef.number;
+        block->shift.number *= coef.number;
+        if(!linear_exact(block->scale.number) || !linear_exact(block->shift.number)) return false;
+    }
+    block->shift.number += term.number;
+    return linear_exact(block->shift.number);
+}
+
+/**
+ * Evaluates the coefficients and the terms of the rows of a block and composes
+ * the map of the block. Stops at the first row whose integer arithmetic fails.
+ *
+ * @param arg Pointer to the Linear_Block.
+ * @return NULL.
+ */
+void *linear_block_terms(void *arg)
+{
+    Linear_Block *block = arg;
+    const Column_Run *run = block->run;
+    Table *table = block->table;
+
+    block->exact = true;
+    if(block->type == VALUE_TYPE_INT) {
+        block->scale.integer = 1;
+        block->shift.integer = 0;
+    } else {
+        block->scale.number = 1.0;
+        block->shift.number = 0.0;
+    }
+
+    block->terms_end = block->row_end;
+    for(size_t row = block->row_begin; row < block->row_end; ++row) {
+        Cell_Offset offset = table_formula(table, row * table->cols + run->col)->offset;
+        size_t k = row - run->row_begin;
+
+        if(block->type == VALUE_TYPE_INT) {
+            if((run->affine && !table_eval_expr_int(table, block->bc, run->coef, offset, &block->coefs[k].integer))
+                || !table_eval_expr_int(table, block->bc, run->term, offset, &block->terms[k].integer)) {
+                block->terms_end = row;
+                break;
+            }
+        } else {
+            if(run->affine) {
+                block->coefs[k].number = table_eval_expr_number(table, block->bc, run->coef, offset);
+            }
+            block->terms[k].number = table_eval_expr_number(table, block->bc, run->term, offset);
+        }
+
+        if(block->exact) {
+            block->exact = linear_compose(block, k);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Computes the rows of a block with terms one after another from the value above the block
+ * and stores them. Stops at the first row whose integer arithmetic overflows.
+ *
+ * @param arg Pointer to the Linear_Block.
+ * @return NULL.
+ */
+void *linear_block_apply(void *arg)
+{
+    Linear_Block *block = arg;
+    const Column_Run *run = block->run;
+
+    Vm_Value value = block->start;
+    block->limit = block->terms_end;
+    for(size_t row = block->row_begin; row < block->terms_end; ++row) {
+        if(!linear_step(block, row - run->row_begin, value, &value)) {
+            block->limit = row;
+            break;
+        }
+
+        size_t cell = row * block->table->cols + run->col;
+        if(block->type == VALUE_TYPE_INT) {
+            table_set_integer(block->table, cell, value.integer);
+        } else {
+            table_set_number(block->table, cell, value.number);
+        }
+    }
+    block->end = value;
+    return NULL;
+}
+
+/**
+ * Evaluates the rows of a linear run from the given one on as a blocked prefix scan.
+ * The blocks evaluate their terms in parallel and compose the map they apply to the value
+ * above them, the values above the blocks are scanned from the seed, and every block then
+ * computes its rows in parallel exactly like the serial evaluation does. The scan is only
+ * attempted while the composition stays exact, and a block is only kept if the previous one
+ * ends with the value the scan started it from, so the results are bit-identical to the
+ * serial evaluation. The blocks the scan did not reach or got wrong are computed serially.
+ *
+ * @param table Pointer to the table structure.
+ * @param bc Pointer to the bytecode with every formula of the table compiled.
+ * @param run Pointer to the linear run.
+ * @param row_begin First row to evaluate, the row above it is evaluated.
+ * @param jobs Number of threads.
+ * @return The first row whose integer arithmetic fails, or the end of the run.
+ */
+size_t table_eval_linear_rows(Table *table, Bytecode *bc, const Column_Run *run, size_t row_begin, size_t jobs)
+{
+    size_t rows = run->row_end - row_begin;
+    size_t blocks_count = 1;
+#ifdef PARALLEL_SUPPORTED
+    if(jobs > 1 && rows >= LINEAR_RUN_PARALLEL_ROWS) {
+        blocks_count = jobs;
+    }
+#else
+    (void) jobs;
+#endif
+
+    // An integral formula falls back to doubles for good once it reads a double above it
+    size_t seed = (row_begin - 1) * table->cols + run->col;
+    Value_Type type = run->type == VALUE_TYPE_INT && table_type(table, seed) == VALUE_TYPE_INT ? VALUE_TYPE_INT : VALUE_TYPE_DOUBLE;
+
+    Vm_Value *coefs = calloc(run->row_end - run->row_begin, sizeof(*coefs));
+    Vm_Value *terms = calloc(run->row_end - run->row_begin, sizeof(*terms));
+    Linear_Block *blocks = malloc(sizeof(*blocks) * blocks_count);
+    for(size_t k = 0; k < blocks_count; ++k) {
+        blocks[k] = (Linear_Block) {
+            .table = table,
+            .bc = bc,
+            .run = run,
+            .type = type,
+            .coefs = coefs,
+            .terms = terms,
+            .row_begin = row_begin + rows * k / blocks_count,
+            .row_end = row_begin + rows * (k + 1) / blocks_count,
+        };
+    }
+
+#ifdef PARALLEL_SUPPORTED
+    Bytecode *copies = malloc(sizeof(*copies) * blocks_count);
+    for(size_t k = 1; k < blocks_count; ++k) {
+        copies[k] = bytecode_worker_copy(bc);
+        blocks[k].bc = &copies[k];
+    }
+    parallel_run(blocks_count, linear_block_terms, blocks, sizeof(*blocks));
+#else
+    linear_block_terms(blocks);
+#endif
+
+    // Scan the values above the blocks from the seed
+    Vm_Value value = {0};
+    if(type == VALUE_TYPE_INT) {
+        value.integer = table_integer(table, seed);
+    } else {
+        value.number = table_number(table, seed);
+    }
+    size_t scanned = 0;
+    bool exact = true;
+    while(exact && scanned < blocks_count) {
+        Linear_Block *block = &blocks[scanned++];
+        block->start = value;
+        if(block->terms_end < block->row_end || !block->exact) break;
+
+        if(type == VALUE_TYPE_INT) {
+            exact = vm_mul_int(block->scale.integer, value.integer, &value.integer)
+                && vm_add_int(value.integer, block->shift.integer, &value.integer);
+        } else {
+            exact = linear_exact(value.number);
+            value.number *= block->scale.number;
+            exact = exact && linear_exact(value.number);
+            value.number += block->shift.number;
+            exact = exact && linear_exact(value.number);
+        }
+    }
+
+#ifdef PARALLEL_SUPPORTED
+    parallel_run(scanned, linear_block_apply, blocks, sizeof(*blocks));
+    for(size_t k = 1; k < blocks_count; ++k) {
+        free(copies[k].stack);
+    }
+    free(copies);
+#else
+    linear_block_apply(blocks);
+#endif
+
+    size_t resume = run->row_end;
+    for(size_t k = 0; k < blocks_count; ++k) {
+        Linear_Block *block = &blocks[k];
+        if(k > 0 && (k >= scanned || memcmp(&blocks[k - 1].end, &block->start, sizeof(block->start)) != 0)) {
+            // Not reached by the scan, or started from a value the serial evaluation does not get
+            block->start = blocks[k - 1].end;
+            linear_block_apply(block);
+        }
+        if(block->limit < block->row_end) {
+            resume = block->limit;
+            break;
+        }
+    }
+
+    free(blocks);
+    free(terms);
+    free(coefs);
+    return resume;
+}
+
+/**
+ * Fills the rows of a linear run from the given one on in closed form, when its term is a
+ * constant step and its coefficient, if any, is exactly one: the row k below the seed
+ * is seed + k*step. Every value of such a sequence lies between the seed and the last row,
+ * so checking that both ends are exact proves that the sequence equals the serial evaluation.
+ *
+ * @param table Pointer to the table structure.
+ * @param bc Pointer to the bytecode with every formula of the table compiled.
+ * @param run Pointer to the linear run whose formula reads no cells besides prev.
+ * @param row_begin First row to fill, the row above it is evaluated.
+ * @return true if the rows are filled, false if the sequence is not exact.
+ */
+bool table_fill_linear_rows(Table *table, Bytecode *bc, const Column_Run *run, size_t row_begin)
+{
+    Cell_Offset offset = table_formula(table, row_begin * table->cols + run->col)->offset;
+    size_t seed = (row_begin - 1) * table->cols + run->col;
+    size_t rows = run->row_end - row_begin;
+    if(rows > INT64_MAX) return false;
+
+    if(run->type == VALUE_TYPE_INT && table_type(table, seed) == VALUE_TYPE_INT) {
+        int64_t coef = 1;
+        int64_t step = 0;
+        if(run->affine && !table_eval_expr_int(table, bc, run->coef, offset, &coef)) return false;
+        if(coef != 1 || !table_eval_expr_int(table, bc, run->term, offset, &step)) return false;
+
+        int64_t first = table_integer(table, seed);
+        int64_t last = 0;
+        if(!vm_mul_int((int64_t) rows, step, &last) || !vm_add_int(first, last, &last)) return false;
+
+        for(size_t k = 0; k < rows; ++k) {
+            size_t cell = (row_begin + k) * table->cols + run->col;
+            table_set_integer(table, cell, first + (int64_t) (k + 1) * step);
+        }
+        return true;
+    }
+
+    double coef = 1.0;
+    if(run->affine) {
+        coef = table_eval_expr_number(table, bc, run->coef, offset);
+    }
+    double step = table_eval_expr_number(table, bc, run->term, offset);
+    double first = table_number(table, seed);
+    double span = (double) rows * step;
+    if(coef != 1.0 || !linear_exact(first) || !linear_exact(step) || !linear_exact(span) || !linear_exact(first + span)) return false;
+
+    for(size_t k = 0; k < rows; ++k) {
+        size_t cell = (row_begin + k) * table->cols + run->col;
+        table_set_number(table, cell, first + (double) (k + 1) * step);
+    }
+    return true;
+}
+
+/**
+ * Evaluates a linear run with table_eval_linear_rows, or table_fill_linear_rows when it
+ * is a constant sequence. The rows whose integer arithmetic fails are evaluated on their
+ * own, which promotes them to doubles, and the rest of the run is scanned again.
+ *
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode with every formula of the table compiled.
+ * @param run Pointer to the linear run, whose seed is evaluated.
+ * @param jobs Number of threads.
+ */
+void table_eval_linear_run(Table *table, Expr_Buffer *eb, Bytecode *bc, const Column_Run *run, size_t jobs)
+{
+    size_t row = run->row_begin;
+    while(row < run->row_end) {
+        if(run->constant && table_fill_linear_rows(table, bc, run, row)) break;
+        row = table_eval_linear_rows(table, bc, run, row, jobs);
+        if(row < run->row_end) {
+            Cell_Index cell_index = { .row = row, .col = run->col };
+            table_eval_expr(table, eb, bc, cell_index);
+            row += 1;
+        }
+    }
+}
+
+#define BATCH_LANES 4
+
+// The lanes of a batch are computed with AVX where the CPU supports it
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(BATCH_NO_AVX)
+#define BATCH_AVX
+#endif
+
+// Rows of a batch run evaluated together by the lanes of the registers
+typedef struct {
+    Table *table;
+    size_t lanes;                        // Number of rows in the batch, at most BATCH_LANES
+    Cell_Index cells[BATCH_LANES];
+    Cell_Offset offsets[BATCH_LANES];
+    bool integral[BATCH_LANES];          // The row is still computed with integer arithmetic
+    int64_t (*integers)[BATCH_LANES];    // Integer registers of the program, one lane per row
+    double (*regs)[BATCH_LANES];         // Floating point registers of the program
+    bool avx;
+} Batch;
+
+#ifdef BATCH_AVX
+/**
+ * Computes a binary operation over all the lanes with AVX instructions, with the same
+ * results as the virtual machine, errors included.
+ *
+ * @param kind Kind of the operation, one of the four arithmetic operations.
+ * @param dst Lanes of the result.
+ * @param lhs Lanes of the left-hand side.
+ * @param rhs Lanes of the right-hand side.
+ */
+__attribute__((target("avx2")))
+void batch_bop_avx(Bop_Kind kind, double *dst, const double *lhs, const double *rhs)
+{
+    static_assert(BATCH_LANES == 4, "AVX registers hold four doubles");
+    __m256d a = _mm256_loadu_pd(lhs);
+    __m256d b = _mm256_loadu_pd(rhs);
+    __m256d result;
+    switch(kind) {
+        case BOP_KIND_PLUS:  result = _mm256_add_pd(a, b); break;
+        case BOP_KIND_MINUS: result = _mm256_sub_pd(a, b); break;
+        case BOP_KIND_MULT:  result = _mm256_mul_pd(a, b); break;
+        case BOP_KIND_DIV: {
+            __m256d by_zero = _mm256_cmp_pd(b, _mm256_setzero_pd(), _CMP_EQ_OQ);
+            result = _mm256_blendv_pd(_mm256_div_pd(a, b), _mm256_set1_pd(error_value(ERROR_KIND_DIV0)), by_zero);
+        } break;
+        case BOP_KIND_POW:
+        case BOP_KIND_MOD:
+        case COUNT_BOP_KINDS:
+        default:
+            UNREACHABLE("Binary operator without an AVX instruction");
+    }
+    // Like the virtual machine, the lanes whose left-hand side is an error keep it
+    result = _mm256_blendv_pd(result, a, _mm256_cmp_pd(a, a, _CMP_UNORD_Q));
+    _mm256_storeu_pd(dst, result);
+}
+#endif // BATCH_AVX
+
+/**
+ * Loads an operand of an instruction for every lane of the batch.
+ * Cells are gathered from the rows of the lanes.
+ *
+ * @param batch Pointer to the batch.
+ * @param kind Kind of the operand.
+ * @param operand The operand.
+ * @param out Lanes of the operand.
+ */
+void batch_operand(Batch *batch, Operand_Kind kind, Operand_As operand, double *out)
+{
+    switch(kind) {
+        case OPERAND_REG:
+            memcpy(out, batch->regs[operand.reg], sizeof(batch->regs[operand.reg]));
+            break;
+        case OPERAND_CELL:
+            for(size_t lane = 0; lane < BATCH_LANES; ++lane) {
+                if(lane >= batch->lanes) {
+                    out[lane] = 0.0;
+                    continue;
+                }
+                out[lane] = table_load_number(batch->table, operand.cell, batch->offsets[lane]);
+            }
+            break;
+        case OPERAND_CONST:
+            for(size_t lane = 0; lane < BATCH_LANES; ++lane) {
+                out[lane] = operand.constant.number;
+            }
+            break;
+        case COUNT_OPERAND_KINDS:
+        default:
+            UNREACHABLE("Unknown operand kind");
+    }
+}
+
+/**
+ * Loads an operand of an instruction as an integer for every lane of the batch still
+ * computed with integer arithmetic. A lane loading a double cell leaves it.
+ *
+ * @param batch Pointer to the batch.
+ * @param kind Kind of the operand.
+ * @param operand The operand.
+ * @param out Lanes of the operand.
+ */
+void batch_operand_int(Batch *batch, Operand_Kind kind, Operand_As operand, int64_t *out)
+{
+    switch(kind) {
+        case OPERAND_REG:
+            memcpy(out, batch->integers[operand.reg], sizeof(batch->integers[operand.reg]));
+            break;
+        case OPERAND_CELL:
+            for(size_t lane = 0; lane < BATCH_LANES; ++lane) {
+                out[lane] = 0;
+                if(!batch->integral[lane]) continue;
+                if(!table_load_int(batch->table, operand.cell, batch->offsets[lane], &out[lane])) {
+                    batch->integral[lane] = false;
+                    continue;
+                }
+            }
+            break;
+        case OPERAND_CONST:
+            for(size_t lane = 0; lane < BATCH_LANES; ++lane) {
+                out[lane] = operand.constant.integer;
+            }
+            break;
+        case COUNT_OPERAND_KINDS:
+        default:
+            UNREACHABLE("Unknown operand kind");
+    }
+}
+
+/**
+ * Runs an integral program with integer arithmetic over the lanes of the batch, like
+ * table_eval_expr_int does. The lanes whose arithmetic fails leave integer arithmetic.
+ *
+ * @param batch Pointer to the batch with the registers reserved.
+ * @param bc Pointer to the bytecode.
+ * @param program The program.
+ * @param out Lanes of the result.
+ */
+void batch_run_int(Batch *batch, const Bytecode *bc, Program program, int64_t *out)
+{
+    for(size_t pc = program.start;; ++pc) {
+        const Inst *inst = &bc->items[pc];
+        const Operand_Kind *kinds = inst_operand_kinds[inst->kind];
+        int64_t lhs[BATCH_LANES];
+        int64_t rhs[BATCH_LANES];
+        batch_operand_int(batch, kinds[0], inst->a, lhs);
+        if(kinds[1] != COUNT_OPERAND_KINDS) {
+            batch_operand_int(batch, kinds[1], inst->b, rhs);
+        }
+
+        int64_t *dst = batch->integers[inst->dst];
+        switch(inst->kind) {
+            case INST_LOAD_CONST:
+            case INST_LOAD_CELL:
+                memcpy(dst, lhs, sizeof(lhs));
+                break;
+            case INST_NEG_REG:
+            case INST_NEG_CELL:
+                for(size_t lane = 0; lane < BATCH_LANES; ++lane) {
+                    batch->integral[lane] = batch->integral[lane] && vm_neg_int(lhs[lane], &dst[lane]);
+                }
+                break;
+#define X(name, kind, fn, int_fn, lhs_kind, rhs_kind)                                                   \
+            case INST_##name##_##lhs_kind##_##rhs_kind:                                                 \
+                for(size_t lane = 0; lane < BATCH_LANES; ++lane) {                                      \
+                    batch->integral[lane] = batch->integral[lane] && int_fn(lhs[lane], rhs[lane], &dst[lane]); \
+                }                                                                                       \
+                break;
+            VM_BOP_SHAPES(X)
+#undef X
+            case INST_RET:
+                memcpy(out, lhs, sizeof(lhs));
+                return;
+            case COUNT_INST_KINDS:
+            default:
+                UNREACHABLE("Unknown instruction kind");
+        }
+    }
 }
 
 /**
- * Converts a String_View to a double.
- * Creates a temporary null-terminated string and uses strtod for conversion.
- * 
- * @param sv The String_View to convert.
- * @param tc Pointer to a temporary C-string structure.
- * @param out Pointer to store the resulting double value.
- * @return true if conversion succeeded, false otherwise.
+ * Computes a binary operation over every lane of the batch, exactly like the virtual machine does.
+ *
+ * @param batch Pointer to the batch.
+ * @param kind Kind of the operation.
+ * @param fn Floating point implementation of the operation.
+ * @param dst Lanes of the result.
+ * @param lhs Lanes of the left-hand side.
+ * @param rhs Lanes of the right-hand side.
  */
-bool sv_strtod(String_View sv, Tmp_Cstr *tc, double *out)
+void batch_bop(const Batch *batch, Bop_Kind kind, double (*fn)(double, double), double *dst, const double *lhs, const double *rhs)
 {
-    char *ptr = tmp_cstr_fill(tc, sv.data, sv.count);
-    char *endptr = NULL;
-    double result = strtod(ptr, &endptr);
-    if (out) *out = result;
-    return endptr != ptr && *endptr == '\0';
+#ifdef BATCH_AVX
+    if(batch->avx && kind != BOP_KIND_POW && kind != BOP_KIND_MOD) {
+        batch_bop_avx(kind, dst, lhs, rhs);
+        return;
+    }
+#else
+    (void) batch;
+    (void) kind;
+#endif
+    for(size_t lane = 0; lane < BATCH_LANES; ++lane) {
+        dst[lane] = fn(lhs[lane], rhs[lane]);
+    }
 }
 
 /**
- * Converts a String_View to a long integer.
- * Creates a temporary null-terminated string and uses strtol for conversion.
- * 
- * @param sv The String_View to convert.
- * @param tc Pointer to a temporary C-string structure.
- * @param out Pointer to store the resulting long integer value.
- * @return true if conversion succeeded, false otherwise.
+ * Runs a program with floating point arithmetic over every lane of the batch.
+ *
+ * @param batch Pointer to the batch with the registers reserved.
+ * @param bc Pointer to the bytecode.
+ * @param program The program.
+ * @param out Lanes of the result.
  */
-bool sv_strtol(String_View sv, Tmp_Cstr *tc, long int *out)
+void batch_run(Batch *batch, const Bytecode *bc, Program program, double *out)
 {
-    char *ptr = tmp_cstr_fill(tc, sv.data, sv.count);
-    char *endptr = NULL;
-    long int result = strtol(ptr, &endptr, 10);
-    if (out) *out = result;
-    return endptr != ptr && *endptr == '\0';
+    for(size_t pc = program.start;; ++pc) {
+        const Inst *inst = &bc->items[pc];
+        const Operand_Kind *kinds = inst_operand_kinds[inst->kind];
+        double lhs[BATCH_LANES];
+        double rhs[BATCH_LANES];
+        batch_operand(batch, kinds[0], inst->a, lhs);
+        if(kinds[1] != COUNT_OPERAND_KINDS) {
+            batch_operand(batch, kinds[1], inst->b, rhs);
+        }
+
+        double *dst = batch->regs[inst->dst];
+        switch(inst->kind) {
+            case INST_LOAD_CONST:
+            case INST_LOAD_CELL:
+                memcpy(dst, lhs, sizeof(lhs));
+                break;
+            case INST_NEG_REG:
+            case INST_NEG_CELL:
+                for(size_t lane = 0; lane < BATCH_LANES; ++lane) {
+                    dst[lane] = -lhs[lane];
+                }
+                break;
+#define X(name, kind, fn, int_fn, lhs_kind, rhs_kind)          \
+            case INST_##name##_##lhs_kind##_##rhs_kind:        \
+                batch_bop(batch, kind, fn, dst, lhs, rhs);     \
+                break;
+            VM_BOP_SHAPES(X)
+#undef X
+            case INST_RET:
+                memcpy(out, lhs, sizeof(lhs));
+                return;
+            case COUNT_INST_KINDS:
+            default:
+                UNREACHABLE("Unknown instruction kind");
+        }
+    }
 }
 
-Expr_Index parse_expr(Lexer *lexer, Tmp_Cstr *tc, Expr_Buffer *eb);
+/**
+ * Evaluates a batch run BATCH_LANES rows at a time. An integral formula is tried with
+ * integer arithmetic first and the rows it fails for are computed with doubles, exactly
+ * like table_eval_expr does for every cell.
+ *
+ * @param table Pointer to the table structure.
+ * @param bc Pointer to the bytecode with every formula of the table compiled.
+ * @param run Pointer to the batch run, whose dependencies are evaluated.
+ */
+void table_eval_batch_run(Table *table, Bytecode *bc, const Column_Run *run)
+{
+    Batch batch = {
+        .table = table,
+    };
+    batch.regs = malloc(sizeof(*batch.regs) * (run->formula.regs + 1));
+    batch.integers = malloc(sizeof(*batch.integers) * (run->formula.regs + 1));
+#ifdef BATCH_AVX
+    batch.avx = __builtin_cpu_supports("avx2");
+#endif
+
+    for(size_t row = run->row_begin; row < run->row_end; row += BATCH_LANES) {
+        batch.lanes = run->row_end - row < BATCH_LANES ? run->row_end - row : BATCH_LANES;
+        for(size_t lane = 0; lane < BATCH_LANES; ++lane) {
+            batch.integral[lane] = run->formula.integral && lane < batch.lanes;
+            if(lane >= batch.lanes) continue;
+            batch.cells[lane] = (Cell_Index) { .row = row + lane, .col = run->col };
+            batch.offsets[lane] = table_formula(table, table_cell_at(table, batch.cells[lane]))->offset;
+        }
+
+        bool doubles = !run->formula.integral;
+        if(run->formula.integral) {
+            int64_t integers[BATCH_LANES];
+            batch_run_int(&batch, bc, run->formula, integers);
+            for(size_t lane = 0; lane < batch.lanes; ++lane) {
+                if(!batch.integral[lane]) {
+                    doubles = true;
+                    continue;
+                }
+                size_t cell = table_cell_at(table, batch.cells[lane]);
+                table_set_integer(table, cell, integers[lane]);
+            }
+        }
+        if(!doubles) continue;
+
+        double numbers[BATCH_LANES];
+        batch_run(&batch, bc, run->formula, numbers);
+        for(size_t lane = 0; lane < batch.lanes; ++lane) {
+            if(batch.integral[lane]) continue;
+            size_t cell = table_cell_at(table, batch.cells[lane]);
+            table_set_number(table, cell, numbers[lane]);
+        }
+    }
+
+    free(batch.integers);
+    free(batch.regs);
+}
 
 /**
- * Parses a primary expression (number or cell reference).
- * Handles the most basic elements of expressions.
- * 
- * @param lexer Pointer to the lexer structure.
- * @param tc Pointer to a temporary C-string structure.
+ * Evaluates every expression cell of the table in the topological order of the graph.
+ * Every formula finds its dependencies evaluated, so nothing recurses and no cell is checked.
+ * Linear runs are evaluated as prefix scans on the given number of threads, batch runs
+ * several rows at a time.
+ *
+ * @param table Pointer to the table structure.
  * @param eb Pointer to the expression buffer.
- * @return Index of the parsed primary expression.
+ * @param bc Pointer to the bytecode.
+ * @param graph Pointer to the dependency graph of the table.
+ * @param jobs Number of threads.
  */
-Expr_Index parse_primary_expr(Lexer *lexer, Tmp_Cstr *tc, Expr_Buffer *eb) 
+void table_eval_graph(Table *table, Expr_Buffer *eb, Bytecode *bc, const Dep_Graph *graph, size_t jobs)
 {
-    Token token = lexer_next_token(lexer);
+    for(size_t k = 0; k < graph->order_count; ++k) {
+        size_t i = graph->order[k];
+        if(graph->run_by_cell[i] != 0) {
+            // The whole run follows in the order
+            const Column_Run *run = &graph->runs[graph->run_by_cell[i] - 1];
+            switch(run->kind) {
+                case RUN_KIND_LINEAR:
+                    table_eval_linear_run(table, eb, bc, run, jobs);
+                    break;
+                case RUN_KIND_BATCH:
+                    table_eval_batch_run(table, bc, run);
+                    break;
+                default:
+                    UNREACHABLE("Unknown run kind");
+            }
+            k += run->row_end - run->row_begin - 1;
+            continue;
+        }
 
-    if (token.text.count == 0) {
-        lexer_print_loc(lexer, stderr);
-        fprintf(stderr, "ERROR: expected primary expression token, but got end of input\n");
-        exit(1);
+        Cell_Index cell_index = { .row = i / table->cols, .col = i % table->cols };
+        table_eval_expr(table, eb, bc, cell_index);
     }
+}
 
-    double number = 0.0;
+#ifdef PARALLEL_SUPPORTED
 
-    if (sv_strtod(token.text, tc, &number)) {
-        Expr_Index expr_index = expr_buffer_alloc(eb);
-        Expr *expr = expr_buffer_at(eb, expr_index);
-        expr->kind = EXPR_KIND_NUMBER;
-        expr->as.number = number;
-        expr->file_path = token.file_path;
-        expr->file_row = token.file_row;
-        expr->file_col = token.file_col;
-        return expr_index;
-    } else if(sv_eq(token.text, SV("("))) {
-        Expr_Index expr_index = parse_expr(lexer, tc, eb);
-        token = lexer_next_token(lexer);
-        if(!sv_eq(token.text, SV(")"))) {
-            fprintf(stderr, "%s:%zu:%zu: ERROR: expected token ')' but got '"SV_Fmt"'\n", 
-                token.file_path, token.file_row, token.file_col, SV_Arg(token.text));
-            exit(1);
+#define DEQUE_EMPTY SIZE_MAX
+#define DEQUE_ABORT (SIZE_MAX - 1)
+
+// Circular array of a work-stealing deque
+typedef struct {
+    long long capacity; // Power of two
+    atomic_size_t items[];
+} Deque_Array;
+
+// Chase-Lev work-stealing deque of cell indices. The owner pushes and takes
+// at the bottom, the other workers steal from the top. The arrays replaced
+// when the deque grows may still be read by stealers, so they are only freed
+// together with the deque.
+typedef struct {
+    atomic_llong top;
+    char top_padding[64];
+    atomic_llong bottom;
+    _Atomic(Deque_Array *) array;
+    char bottom_padding[64];
+
+    Deque_Array **retired;
+    size_t retired_count;
+    size_t retired_capacity;
+} Deque;
+
+/**
+ * Allocates a circular array of a deque.
+ *
+ * @param capacity Capacity of the array, a power of two.
+ * @return Pointer to the array.
+ */
+Deque_Array *deque_array_alloc(long long capacity)
+{
+    Deque_Array *array = malloc(sizeof(*array) + sizeof(array->items[0]) * (size_t) capacity);
+    array->capacity = capacity;
+    return array;
+}
+
+/**
+ * Initializes an empty deque.
+ *
+ * @param deque Pointer to the deque.
+ */
+void deque_init(Deque *deque)
+{
+    memset(deque, 0, sizeof(*deque));
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, deque_array_alloc(256));
+}
+
+/**
+ * Pushes a cell at the bottom of the deque. Called by the owner only.
+ *
+ * @param deque Pointer to the deque.
+ * @param item The cell.
+ */
+void deque_push(Deque *deque, size_t item)
+{
+    long long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    Deque_Array *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    if(b - t > array->capacity - 1) {
+        Deque_Array *grown = deque_array_alloc(array->capacity * 2);
+        for(long long i = t; i < b; ++i) {
+            size_t moved = atomic_load_explicit(&array->items[i & (array->capacity - 1)], memory_order_relaxed);
+            atomic_store_explicit(&grown->items[i & (grown->capacity - 1)], moved, memory_order_relaxed);
         }
 
-        return expr_index;
-    } else if (sv_eq(token.text, SV("-"))){
-        Expr_Index param_index = parse_expr(lexer, tc, eb);
-        Expr_Index expr_index = expr_buffer_alloc(eb);
-        {
-            Expr *expr = expr_buffer_at(eb, expr_index);
-            expr->kind = EXPR_KIND_UOP;
-            expr->as.uop.kind = UOP_KIND_MINUS;
-            expr->as.uop.param = param_index;
-            expr->file_path = token.file_path;
-            expr->file_row = token.file_row;
-            expr->file_col = token.file_col;
+        if(deque->retired_count >= deque->retired_capacity) {
+            deque->retired_capacity = deque->retired_capacity == 0 ? 8 : deque->retired_capacity * 2;
+            deque->retired = realloc(deque->retired, sizeof(*deque->retired) * deque->retired_capacity);
         }
-        return expr_index;
-    } else {
-        Expr_Index expr_index = expr_buffer_alloc(eb);
-        Expr *expr = expr_buffer_at(eb, expr_index);
-        expr->file_path = token.file_path;
-        expr->file_row = token.file_row;
-        expr->file_col = token.file_col;
-        expr->kind = EXPR_KIND_CELL;
+        deque->retired[deque->retired_count++] = array;
 
-        if (!isupper(*token.text.data)) {
-            lexer_print_loc(lexer, stderr);
-            fprintf(stderr, "ERROR: cell reference must start with capital letter\n");
-            exit(1);
+        atomic_store_explicit(&deque->array, grown, memory_order_release);
+        array = grown;
+    }
+
+    atomic_store_explicit(&array->items[b & (array->capacity - 1)], item, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+}
+
+/**
+ * Takes the cell at the bottom of the deque. Called by the owner only.
+ *
+ * @param deque Pointer to the deque.
+ * @return The cell, or DEQUE_EMPTY if the deque is empty.
+ */
+size_t deque_take(Deque *deque)
+{
+    long long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    Deque_Array *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if(t > b) {
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return DEQUE_EMPTY;
+    }
+
+    size_t item = atomic_load_explicit(&array->items[b & (array->capacity - 1)], memory_order_relaxed);
+    if(t == b) {
+        // The last cell, race the stealers for it
+        if(!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+            item = DEQUE_EMPTY;
         }
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    }
+    return item;
+}
+
+/**
+ * Steals the cell at the top of the deque. Called by any worker.
+ *
+ * @param deque Pointer to the deque.
+ * @return The cell, DEQUE_EMPTY if the deque is empty, or DEQUE_ABORT if another worker won the race.
+ */
+size_t deque_steal(Deque *deque)
+{
+    long long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if(t >= b) return DEQUE_EMPTY;
+
+    Deque_Array *array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    size_t item = atomic_load_explicit(&array->items[t & (array->capacity - 1)], memory_order_relaxed);
+    if(!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return DEQUE_ABORT;
+    }
+    return item;
+}
+
+/**
+ * Releases all the memory owned by the deque.
+ *
+ * @param deque Pointer to the deque.
+ */
+void deque_free(Deque *deque)
+{
+    for(size_t i = 0; i < deque->retired_count; ++i) {
+        free(deque->retired[i]);
+    }
+    free(deque->retired);
+    free(atomic_load(&deque->array));
+    memset(deque, 0, sizeof(*deque));
+}
 
-        expr->as.cell.col = *token.text.data - 'A';
+// State of a parallel evaluation shared by all of the workers
+typedef struct {
+    Table *table;
+    Expr_Buffer *eb;
+    const Bytecode *bc;
+    const Dep_Graph *graph;
 
-        sv_chop_left(&token.text, 1);
+    atomic_size_t *pending;   // Number of not yet evaluated dependencies of every cell
+    atomic_size_t remaining;  // Number of not yet evaluated expression cells
+    Deque *deques;            // Deque of every worker
+    size_t jobs;
+} Parallel_Eval;
 
-        long int row = 0;
-        if (!sv_strtol(token.text, tc, &row)) {
-            lexer_print_loc(lexer, stderr);
-            fprintf(stderr, "ERROR: cell reference must have an integer as the row number\n" );
-            exit(1);
+typedef struct {
+    Parallel_Eval *eval;
+    size_t id;
+} Parallel_Worker;
+
+/**
+ * Runs a worker of the parallel evaluation until every expression cell is evaluated.
+ * A worker evaluates the cells of its own deque and steals from random other workers
+ * when it runs out of them. Evaluating a cell pushes every user of the cell whose last
+ * pending dependency it was.
+ *
+ * @param arg Pointer to the Parallel_Worker.
+ * @return NULL.
+ */
+void *parallel_worker_run(void *arg)
+{
+    Parallel_Worker *worker = arg;
+    Parallel_Eval *eval = worker->eval;
+    const Dep_Graph *graph = eval->graph;
+    Deque *own = &eval->deques[worker->id];
+
+    Bytecode bc = bytecode_worker_copy(eval->bc);
+
+    uint64_t random = 0x9E3779B97F4A7C15ULL * (worker->id + 1);
+    while(atomic_load_explicit(&eval->remaining, memory_order_acquire) > 0) {
+        size_t i = deque_take(own);
+        if(i == DEQUE_EMPTY) {
+            random ^= random << 13;
+            random ^= random >> 7;
+            random ^= random << 17;
+            size_t victim = (size_t) (random % eval->jobs);
+            i = victim == worker->id ? DEQUE_EMPTY : deque_steal(&eval->deques[victim]);
+            if(i == DEQUE_EMPTY || i == DEQUE_ABORT) {
+                sched_yield();
+                continue;
+            }
         }
 
-        expr->as.cell.row = (size_t) row;
-        return expr_index;
+        Cell_Index cell_index = { .row = i / eval->table->cols, .col = i % eval->table->cols };
+        table_eval_expr(eval->table, eval->eb, &bc, cell_index);
+
+        for(size_t k = graph->users_start[i]; k < graph->users_start[i + 1]; ++k) {
+            size_t user = graph->users[k];
+            if(atomic_fetch_sub_explicit(&eval->pending[user], 1, memory_order_acq_rel) == 1) {
+                deque_push(own, user);
+            }
+        }
+        atomic_fetch_sub_explicit(&eval->remaining, 1, memory_order_release);
     }
+
+    assert(bc.count == eval->bc->count && "Every formula must be compiled before the evaluation");
+    free(bc.stack);
+    return NULL;
 }
 
+#endif // PARALLEL_SUPPORTED
 
 /**
- * Parses an binary operation expression.
- * Handles expressions with addition operators, recursively parsing the right-hand side.
- * 
- * @param lexer Pointer to the lexer structure.
- * @param tc Pointer to a temporary C-string structure.
+ * Evaluates every expression cell of the table on multiple threads with work stealing.
+ * Every cell is computed exactly like the serial evaluation does, only the order
+ * of independent cells differs, so the results are bit-identical to it.
+ * Falls back to table_eval_graph on targets without threads.
+ *
+ * @param table Pointer to the table structure.
  * @param eb Pointer to the expression buffer.
- * @param precedence Current precedence of the expression
- * @return Index of the parsed addition expression or primary expression.
+ * @param bc Pointer to the bytecode with every formula of the table compiled.
+ * @param graph Pointer to the dependency graph of the table.
+ * @param jobs Number of threads.
  */
-Expr_Index parse_bop_expr(Lexer *lexer, Tmp_Cstr *tc, Expr_Buffer *eb, size_t precedence)
+void table_eval_graph_parallel(Table *table, Expr_Buffer *eb, Bytecode *bc, const Dep_Graph *graph, size_t jobs)
 {
-    if (precedence >= COUNT_BOP_PRECEDENCE) {
-        return parse_primary_expr(lexer, tc, eb);
+#ifdef PARALLEL_SUPPORTED
+    if(jobs <= 1) {
+        table_eval_graph(table, eb, bc, graph, 1);
+        return;
     }
 
-    Expr_Index lhs_index = parse_bop_expr(lexer, tc, eb, precedence + 1);
+    Parallel_Eval eval = {
+        .table = table,
+        .eb = eb,
+        .bc = bc,
+        .graph = graph,
+        .jobs = jobs,
+    };
+    atomic_init(&eval.remaining, graph->order_count);
+    eval.pending = malloc(sizeof(*eval.pending) * (graph->cells_count + 1));
+    eval.deques = malloc(sizeof(*eval.deques) * jobs);
+    for(size_t i = 0; i < jobs; ++i) {
+        deque_init(&eval.deques[i]);
+    }
 
-    Token token = lexer_peek_token(lexer);
-    const Bop_Def *def = bop_def_by_token(token.text);
+    // Deal the cells without dependencies out to the workers
+    size_t sources = 0;
+    for(size_t i = 0; i < graph->cells_count; ++i) {
+        size_t deps = graph->deps_start[i + 1] - graph->deps_start[i];
+        atomic_init(&eval.pending[i], deps);
+        if(table_kind(table, i) == CELL_KIND_EXPR && deps == 0) {
+            deque_push(&eval.deques[sources++ % jobs], i);
+        }
+    }
 
-    if (def != NULL && def->precedence == precedence) {
-        token = lexer_next_token(lexer);
-        Expr_Index rhs_index = parse_bop_expr(lexer, tc, eb, precedence);
+    Parallel_Worker *workers = malloc(sizeof(*workers) * jobs);
+    for(size_t i = 0; i < jobs; ++i) {
+        workers[i] = (Parallel_Worker) { .eval = &eval, .id = i };
+    }
+    parallel_run(jobs, parallel_worker_run, workers, sizeof(*workers));
 
-        Expr_Index expr_index = expr_buffer_alloc(eb);
-        {
-            Expr *expr = expr_buffer_at(eb, expr_index);
-            expr->kind = EXPR_KIND_BOP;
-            expr->as.bop.kind = def->kind;
-            expr->as.bop.lhs = lhs_index;
-            expr->as.bop.rhs = rhs_index;
-            expr->file_path = token.file_path;
-            expr->file_row = token.file_row;
-            expr->file_col = token.file_col;
+    for(size_t i = 0; i < jobs; ++i) {
+        deque_free(&eval.deques[i]);
+    }
+    free(workers);
+    free(eval.deques);
+    free(eval.pending);
+#else
+    (void) jobs;
+    table_eval_graph(table, eb, bc, graph, 1);
+#endif
+}
+
+/**
+ * Checks whether every formula of the table reads only cells that are neither below
+ * nor to the right of its own cell. Such tables are evaluated correctly in row-major
+ * order within any rectangular tile once the tiles above and to the left are done.
+ *
+ * @param graph Pointer to the dependency graph of the table.
+ * @param cols Number of columns of the table.
+ * @return true if all of the dependencies point up and left.
+ */
+bool dep_graph_is_up_left(const Dep_Graph *graph, size_t cols)
+{
+    for(size_t i = 0; i < graph->cells_count; ++i) {
+        for(size_t k = graph->deps_start[i]; k < graph->deps_start[i + 1]; ++k) {
+            size_t dep = graph->deps[k];
+            if(dep / cols > i / cols || dep % cols > i % cols) return false;
         }
+    }
+    return true;
+}
 
-        return expr_index;
+#ifdef PARALLEL_SUPPORTED
+
+#define WAVEFRONT_TILE_ROWS 64
+
+// State of a wavefront evaluation shared by all of the tile columns
+typedef struct {
+    Table *table;
+    Expr_Buffer *eb;
+    const Bytecode *bc;
+    size_t tile_cols;      // Width of a tile column
+    atomic_size_t *done;   // Number of rows every tile column has evaluated
+} Wavefront;
+
+typedef struct {
+    Wavefront *wavefront;
+    size_t column;
+} Wavefront_Worker;
+
+/**
+ * Evaluates a tile column from top to bottom, one tile of WAVEFRONT_TILE_ROWS rows at a time.
+ * A tile waits until the tile column to the left has finished the same rows, so the tiles
+ * of all the columns proceed together along the anti-diagonals.
+ *
+ * @param arg Pointer to the Wavefront_Worker.
+ * @return NULL.
+ */
+void *wavefront_worker_run(void *arg)
+{
+    Wavefront_Worker *worker = arg;
+    Wavefront *wavefront = worker->wavefront;
+    Table *table = wavefront->table;
+    size_t column = worker->column;
+    size_t col_begin = column * wavefront->tile_cols;
+    size_t col_end = col_begin + wavefront->tile_cols < table->cols ? col_begin + wavefront->tile_cols : table->cols;
+
+    Bytecode bc = bytecode_worker_copy(wavefront->bc);
+    for(size_t row_begin = 0; row_begin < table->rows; row_begin += WAVEFRONT_TILE_ROWS) {
+        size_t row_end = row_begin + WAVEFRONT_TILE_ROWS < table->rows ? row_begin + WAVEFRONT_TILE_ROWS : table->rows;
+        if(column > 0) {
+            while(atomic_load_explicit(&wavefront->done[column - 1], memory_order_acquire) < row_end) {
+                sched_yield();
+            }
+        }
+
+        for(size_t row = row_begin; row < row_end; ++row) {
+            for(size_t col = col_begin; col < col_end; ++col) {
+                size_t cell = row * table->cols + col;
+                if(table_kind(table, cell) != CELL_KIND_EXPR) continue;
+                Cell_Index cell_index = { .row = row, .col = col };
+                table_eval_expr(table, wavefront->eb, &bc, cell_index);
+            }
+        }
+        atomic_store_explicit(&wavefront->done[column], row_end, memory_order_release);
     }
 
-    return lhs_index;
+    free(bc.stack);
+    return NULL;
 }
 
+#endif // PARALLEL_SUPPORTED
+
 /**
- * Retrieves a cell from the table at a given index.
- * Verifies the index is within bounds before returning.
+ * Evaluates a table whose formulas only read cells up and to the left of them (see
+ * dep_graph_is_up_left) as a blocked wavefront. The columns are split into one tile
+ * column per thread, which avoids scheduling every cell separately like
+ * table_eval_graph_parallel does. Falls back to table_eval_graph on targets without threads.
  *
  * @param table Pointer to the table structure.
- * @param index Index of the cell to retrieve.
- * @return Pointer to the requested cell.
+ * @param eb Pointer to the expression buffer.
+ * @param bc Pointer to the bytecode with every formula of the table compiled.
+ * @param graph Pointer to the dependency graph of the table.
+ * @param jobs Number of threads.
  */
-Cell *table_cell_at(Table *table, Cell_Index index) 
+void table_eval_wavefront(Table *table, Expr_Buffer *eb, Bytecode *bc, const Dep_Graph *graph, size_t jobs)
 {
-    assert(index.row < table->rows);
-    assert(index.col < table->cols);
+#ifdef PARALLEL_SUPPORTED
+    if(jobs <= 1 || table->cols <= 1) {
+        table_eval_graph(table, eb, bc, graph, 1);
+        return;
+    }
 
-    return &table->cells[index.row * table->cols + index.col];
+    size_t tile_cols = (table->cols + jobs - 1) / jobs;
+    size_t columns = (table->cols + tile_cols - 1) / tile_cols;
+    Wavefront wavefront = {
+        .table = table,
+        .eb = eb,
+        .bc = bc,
+        .tile_cols = tile_cols,
+    };
+    wavefront.done = malloc(sizeof(*wavefront.done) * columns);
+    Wavefront_Worker *workers = malloc(sizeof(*workers) * columns);
+    for(size_t i = 0; i < columns; ++i) {
+        atomic_init(&wavefront.done[i], 0);
+        workers[i] = (Wavefront_Worker) { .wavefront = &wavefront, .column = i };
+    }
+    parallel_run(columns, wavefront_worker_run, workers, sizeof(*workers));
+
+    free(workers);
+    free(wavefront.done);
+#else
+    (void) jobs;
+    table_eval_graph(table, eb, bc, graph, 1);
+#endif
 }
 
 /**
- * Dumps the table contents to an output stream.
- * Prints each cell's file location and kind.
+ * Takes the first n characters from a string and returns them as a new null-terminated string.
+ * Helper function for displaying text values.
  *
- * @param stream Output file stream.
- * @param table Pointer to the table structure.
+ * @param input The input string.
+ * @param count Number of characters to take.
+ * @return A newly allocated string containing the first n characters of input, or NULL on error.
  */
-void dump_table(FILE *stream, Table *table) 
-{
-    for(size_t row = 0; row < table->rows; ++row) {
-        for(size_t col = 0; col < table->cols; ++col) {
-            Cell_Index cell_index = {
-                .col = col,
-                .row = row,
-            };
+const char* sv_take_first_n(const char* input, size_t count) {
+    if (input == NULL) {
+        return NULL;
+    }
+    
+    size_t input_length = strlen(input);
+    
+    if (count > input_length) {
+        count = input_length;
+    }
+    
+    char* result = (char*)malloc((count + 1) * sizeof(char));
+    if (result == NULL) {
+        return NULL; // Memory allocation failed
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        result[i] = input[i];
+    }
+    
+    result[count] = '\0';
+    
+    return result;
+}
 
-            Cell *cell = table_cell_at(table, cell_index);
-            fprintf(stream, "%s:%zu:%zu: %s\n", table->file_path, cell->file_row, cell->file_col, cell_kind_as_cstr(cell->kind));
-        }
+// Number of formula cells computed by a single function of the emitted C code
+#define AOT_CHUNK_SIZE 64
+
+/**
+ * Emits a numeric constant as a C double literal that reads back exactly.
+ *
+ * @param stream Output file stream.
+ * @param number The constant.
+ */
+void aot_emit_number(FILE *stream, double number)
+{
+    if(isnan(number)) {
+        fprintf(stream, "NAN");
+    } else if(isinf(number)) {
+        fprintf(stream, number < 0 ? "(-HUGE_VAL)" : "HUGE_VAL");
+    } else {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.17g", number);
+        bool is_integer_literal = strpbrk(buffer, ".e") == NULL;
+        fprintf(stream, number < 0 ? "(%s%s)" : "%s%s", buffer, is_integer_literal ? ".0" : "");
     }
 }
 
 /**
- * Recursively prints an expression tree.
- * Output is indented based on the tree depth to show structure.
+ * Emits a formula as a C expression over the array of cell values `v`.
+ * Cell references are displaced by the offset of the formula template of the emitted cell.
  *
  * @param stream Output file stream.
+ * @param table Pointer to the table structure.
  * @param eb Pointer to the expression buffer.
- * @param expr_index Index of the expression to dump.
- * @param level Current nesting level (for indentation).
+ * @param expr_index Index of the expression to emit.
+ * @param offset Offset of the formula template.
  */
-void dump_expr(FILE *stream, Expr_Buffer *eb, Expr_Index expr_index, int level) 
+void aot_emit_expr(FILE *stream, const Table *table, const Expr_Buffer *eb, Expr_Index expr_index, Cell_Offset offset)
 {
-    fprintf(stream, "%*s", level * 2, "");
-
     Expr *expr = expr_buffer_at(eb, expr_index);
-    
+
     switch(expr->kind) {
         case EXPR_KIND_NUMBER:
-            fprintf(stream, "NUMBER: %lf\n", expr->as.number);
-            break;
-        case EXPR_KIND_CELL:
-            fprintf(stream, "CELL(%zu, %zu)\n", expr->as.cell.row, expr->as.cell.col);
+            aot_emit_number(stream, expr->type == VALUE_TYPE_INT ? (double) expr->as.integer : expr->as.number);
             break;
-        case EXPR_KIND_UOP:
-            switch(expr->as.uop.kind) {
-                case UOP_KIND_MINUS:
-                    fprintf(stream, "UOP(MINUS): \n");
+        case EXPR_KIND_CELL: {
+            Cell_Index target = {0};
+            bool inside = table_offset_index(table, expr->as.cell, offset, &target);
+            assert(inside && "The table must be evaluated before it is compiled");
+            (void) inside;
+            fprintf(stream, "v[%zu]", target.row * table->cols + target.col);
+        } break;
+        case EXPR_KIND_BOP: {
+            Expr_Bop bop = expr->as.bop;
+            switch(bop.kind) {
+                case BOP_KIND_DIV:
+                case BOP_KIND_POW:
+                case BOP_KIND_MOD:
+                    fprintf(stream, bop.kind == BOP_KIND_DIV ? "sheet_div(" : bop.kind == BOP_KIND_POW ? "sheet_pow(" : "sheet_mod(");
+                    aot_emit_expr(stream, table, eb, bop.lhs, offset);
+                    fprintf(stream, ", ");
+                    aot_emit_expr(stream, table, eb, bop.rhs, offset);
+                    fprintf(stream, ")");
                     break;
-                default:
-                    UNREACHABLE("Unknown unary operator kind");
-            }
-
-            dump_expr(stream, eb, expr->as.uop.param, level + 1);
-            break;
-        case EXPR_KIND_BOP:
-            switch(expr->as.bop.kind) {
                 case BOP_KIND_PLUS:
-                    fprintf(stream, "BOP(PLUS): \n");
-                    break;
                 case BOP_KIND_MINUS:
-                    fprintf(stream, "BOP(MINUS): \n");
-                    break;
                 case BOP_KIND_MULT:
-                    fprintf(stream, "BOP(MULT): \n");
-                    break;
-                case BOP_KIND_DIV:
-                    fprintf(stream, "BOP(DIV): \n");
-                    break;
-                case BOP_KIND_POW:
-                    fprintf(stream, "BOP(POW): \n");
-                    break;
-                case BOP_KIND_MOD:
-                    fprintf(stream, "BOP(MOD): \n");
+                    fprintf(stream, "(");
+                    aot_emit_expr(stream, table, eb, bop.lhs, offset);
+                    fprintf(stream, " "SV_Fmt" ", SV_Arg(get_bop_def(bop.kind).token));
+                    aot_emit_expr(stream, table, eb, bop.rhs, offset);
+                    fprintf(stream, ")");
                     break;
                 case COUNT_BOP_KINDS:
                 default: {
                     UNREACHABLE("Unknown binary operator kind");
                 }
             }
-
-            dump_expr(stream, eb, expr->as.bop.lhs, level + 1);
-            dump_expr(stream, eb, expr->as.bop.rhs, level + 1);
+        } break;
+        case EXPR_KIND_UOP:
+            switch(expr->as.uop.kind) {
+                case UOP_KIND_MINUS:
+                    fprintf(stream, "(-");
+                    aot_emit_expr(stream, table, eb, expr->as.uop.param, offset);
+                    fprintf(stream, ")");
+                    break;
+                default:
+                    UNREACHABLE("Unknown unary operator kind");
+            }
             break;
         default: {
             UNREACHABLE("Unknown expression kind");
@@ -730,472 +6233,676 @@ void dump_expr(FILE *stream, Expr_Buffer *eb, Expr_Index expr_index, int level)
 }
 
 /**
- * Parses an expression from the given lexer.
- * This is the entry point for expression parsing.
- *
- * @param lexer Pointer to the lexer structure.
- * @param tc Pointer to a temporary C-string structure.
- * @param eb Pointer to the expression buffer.
- * @return Index of the parsed expression.
- */
-Expr_Index parse_expr(Lexer *lexer, Tmp_Cstr *tc, Expr_Buffer *eb) 
-{
-    return parse_bop_expr(lexer, tc, eb, BOP_PRECEDENCE0);
-}
-
-/**
- * Prints usage information for the program.
- * Displays the correct command-line syntax.
+ * Emits an integer constant as a C long long literal.
  *
  * @param stream Output file stream.
+ * @param integer The constant.
  */
-void print_usage(FILE *stream) 
-{
-    fprintf(stream, "Usage: ./excel-cli <input.csv> <output.csv>\n");
-}
-
-/**
- * Reads the contents of a CSV file into memory.
- * Allocates memory for the file contents and reads the entire file.
- *
- * @param file_path Path to the CSV file.
- * @param size Pointer to store the size of the file.
- * @return Pointer to the allocated buffer containing the file contents, or NULL on error.
- */
-char *read_csv(const char *file_path, size_t *size) 
+void aot_emit_integer(FILE *stream, int64_t integer)
 {
-
-    char *buffer = NULL;
-    FILE *f = fopen(file_path, "rb");
-    if(f == NULL) {
-        goto error;
-    }
-
-    if(fseek(f, 0, SEEK_END) < 0) goto error;
-
-    long m = ftell(f); // size of file
-    if(m < 0) goto error;
-    
-    buffer = malloc(sizeof(char) * m);
-    if(buffer == NULL) goto error;
-
-    if(fseek(f, 0, SEEK_SET) < 0) goto error;
-    
-    size_t n = fread(buffer, 1, m, f);
-    assert(n == (size_t) m);
-
-    if(ferror(f)) goto error;
-
-    if(size) {
-        *size = n;
+    if(integer == INT64_MIN) {
+        // The literal of the minimum is out of range before it is negated
+        fprintf(stream, "(-%" PRId64 "LL - 1)", INT64_MAX);
+    } else {
+        fprintf(stream, integer < 0 ? "(%" PRId64 "LL)" : "%" PRId64 "LL", integer);
     }
-
-    fclose(f);
-    return buffer;
-
-error:
-    if(f) fclose(f);
-    if(buffer) free(buffer);
-
-    return NULL;
 }
 
+// Operand of the integer code of a formula: a constant or a temporary `t[temp]`
+typedef struct {
+    bool constant;
+    int64_t integer;
+    size_t temp;
+} Aot_Int;
+
 /**
- * Parses table content from a String_View into the table structure.
- * Processes each cell in the table and sets up appropriate expressions and references.
+ * Counts the temporaries of the integer code of an integral formula, one per node but the constants.
  *
- * @param table Pointer to the table structure.
  * @param eb Pointer to the expression buffer.
- * @param tc Pointer to a temporary C-string structure.
- * @param content String_View containing the CSV content.
+ * @param expr_index Index of the expression.
+ * @param cells Pointer to the number of cell references, incremented by those of the expression.
+ * @return The number of temporaries.
  */
-void parse_table_from_content(Table *table, Expr_Buffer *eb, Tmp_Cstr *tc, String_View content)
+size_t aot_int_temps(const Expr_Buffer *eb, Expr_Index expr_index, size_t *cells)
 {
-    for (size_t row = 0; row < table->rows; ++row) {
-        String_View line = sv_chop_by_delim(&content, '\n');
-        const char *const line_start = line.data;
-        for (size_t col = 0; col < table->cols; ++col) {
-            String_View cell_value = sv_trim(sv_chop_by_delim(&line, '|'));
-            Cell_Index cell_index = {
-                .col = col,
-                .row = row,
-            };
-
-            Cell *cell = table_cell_at(table, cell_index);
-            cell->file_row = row + 1;
-            cell->file_col = cell_value.data - line_start + 1;
-
-
-            if (sv_starts_with(cell_value, SV("="))) {
-                sv_chop_left(&cell_value, 1);
-                cell->kind = CELL_KIND_EXPR;
-                Lexer lexer = {
-                    .file_path = table->file_path,
-                    .file_row = cell->file_row,
-                    .line_start = line_start,
-                    .source = cell_value,
-                };
-                cell->as.expr.index = parse_expr(&lexer, tc, eb);
-                lexer_expect_no_tokens(&lexer);
-            } else if(sv_starts_with(cell_value, SV(":"))) {
-                sv_chop_left(&cell_value, 1);
-                cell->kind = CELL_KIND_CLONE;
-                if(sv_eq(cell_value, SV("<"))) {
-                    cell->as.clone = DIR_LEFT;
-                } else if(sv_eq(cell_value, SV(">"))) {
-                    cell->as.clone = DIR_RIGHT;
-                } else if(sv_eq(cell_value, SV("^"))) {
-                    cell->as.clone = DIR_UP;
-                } else if(sv_eq(cell_value, SV("v"))) {
-                    cell->as.clone = DIR_DOWN;
-                } else {
-                    fprintf(stderr, "%s:%zu:%zu: ERROR: "SV_Fmt" is not a correct direction to clone a cell from \n", table->file_path, cell->file_row, cell->file_col, SV_Arg(cell_value));
-                    exit(1);
-                }
-            } else {
-                if (sv_strtod(cell_value,tc, &cell->as.number)) {
-                    cell->kind = CELL_KIND_NUMBER;
-                } else {
-                    cell->kind = CELL_KIND_TEXT;
-                    cell->as.text = cell_value;
-                }
-            }
-        }
+    Expr *expr = expr_buffer_at(eb, expr_index);
+    switch(expr->kind) {
+        case EXPR_KIND_NUMBER:
+            return 0;
+        case EXPR_KIND_CELL:
+            *cells += 1;
+            return 1;
+        case EXPR_KIND_BOP:
+            return aot_int_temps(eb, expr->as.bop.lhs, cells) + aot_int_temps(eb, expr->as.bop.rhs, cells) + 1;
+        case EXPR_KIND_UOP:
+            return aot_int_temps(eb, expr->as.uop.param, cells) + 1;
+        default:
+            UNREACHABLE("Unknown expression kind");
     }
 }
 
 /**
- * Estimates the size of a table from its content.
- * Counts the number of rows and maximum number of columns.
+ * Emits an operand of the integer code of a formula.
  *
- * @param content String_View containing the CSV content.
- * @param out_rows Pointer to store the number of rows.
- * @param out_cols Pointer to store the number of columns.
+ * @param stream Output file stream.
+ * @param operand The operand.
  */
-void estimate_table_size(String_View content, size_t *out_rows, size_t *out_cols) 
+void aot_emit_int_operand(FILE *stream, Aot_Int operand)
 {
-    size_t rows = 0;
-    size_t cols = 0;
-    for(; content.count > 0; ++rows) {
-        String_View line = sv_chop_by_delim(&content, '\n');
-
-        size_t col = 0;
-        for(; line.count > 0; ++col) {
-            sv_trim(sv_chop_by_delim(&line, '|'));
-        }
-
-        if(cols < col) {
-            cols = col;
-        }
+    if(operand.constant) {
+        aot_emit_integer(stream, operand.integer);
+    } else {
+        fprintf(stream, "t[%zu]", operand.temp);
     }
-
-    if(out_rows) *out_rows = rows;
-    if(out_cols) *out_cols = cols;
 }
 
-void table_eval_cell(Table *table, Expr_Buffer *eb, Cell_Index cell_index);
-
 /**
- * Evaluates an expression in the context of a table.
- * Handles numeric values, cell references, and addition operations.
+ * Emits an integral formula template as a chain of C conditions computing it with the integer
+ * arithmetic of table_eval_expr_int: the chain fails if a referenced cell is not an integer or the
+ * arithmetic overflows. Cell references are displaced by the row-major `origin` of the cell.
  *
+ * @param stream Output file stream.
  * @param table Pointer to the table structure.
  * @param eb Pointer to the expression buffer.
- * @param expr_index Index of the expression to evaluate.
- * @return The numeric result of evaluating the expression.
+ * @param expr_index Index of the expression to emit.
+ * @param temps Pointer to the number of temporaries used so far.
+ * @return The operand holding the result.
  */
-double table_eval_expr(Table *table, Expr_Buffer *eb, Expr_Index expr_index) 
+Aot_Int aot_emit_int_expr(FILE *stream, const Table *table, const Expr_Buffer *eb, Expr_Index expr_index, size_t *temps)
 {
     Expr *expr = expr_buffer_at(eb, expr_index);
+    assert(expr->type == VALUE_TYPE_INT);
 
     switch(expr->kind) {
         case EXPR_KIND_NUMBER:
-            return expr->as.number;
+            return (Aot_Int) { .constant = true, .integer = expr->as.integer };
         case EXPR_KIND_CELL: {
-            table_eval_cell(table, eb, expr->as.cell);
-
-            Cell *target_cell = table_cell_at(table, expr->as.cell);
-            switch(target_cell->kind) {
-                case CELL_KIND_NUMBER: 
-                    return target_cell->as.number;
-                case CELL_KIND_TEXT: {
-                    fprintf(stderr, "%s:%zu:%zu ERROR: text cells may not participate in math expressions\n", 
-                        expr->file_path, expr->file_row, expr->file_col);
-                    fprintf(stderr, "%s:%zu:%zu: NOTE: the text cell is located here\n", 
-                        table->file_path, target_cell->file_row, target_cell->file_col);
-                    exit(1);
-                } break;
-                case CELL_KIND_EXPR: {
-                    return target_cell->as.expr.value;
-                } break;
-                case CELL_KIND_CLONE: {
-                    UNREACHABLE("Clone cell should be evaluated to the expression cell at this point");
-                } break; 
-            }
-        } break;
+            Aot_Int result = { .temp = (*temps)++ };
+            fprintf(stream, "%ssheet_int(n, integral, origin + %zu, &t[%zu])", result.temp == 0 ? "" : " && ",
+                expr->as.cell.row * table->cols + expr->as.cell.col, result.temp);
+            return result;
+        }
         case EXPR_KIND_BOP: {
-            double lhs = table_eval_expr(table, eb, expr->as.bop.lhs);
-            double rhs = table_eval_expr(table, eb, expr->as.bop.rhs);
-            
-            switch (expr->as.bop.kind) {
-                case BOP_KIND_PLUS: return lhs + rhs;
-                case BOP_KIND_MINUS: return lhs - rhs;
-                case BOP_KIND_MULT: return lhs * rhs;
-                case BOP_KIND_DIV: return lhs / rhs;
-                case BOP_KIND_POW: return bin_pow(lhs, (int) rhs);
-                case BOP_KIND_MOD: return (int)lhs % (int)rhs;
+            Expr_Bop bop = expr->as.bop;
+            Aot_Int lhs = aot_emit_int_expr(stream, table, eb, bop.lhs, temps);
+            Aot_Int rhs = aot_emit_int_expr(stream, table, eb, bop.rhs, temps);
+            Aot_Int result = { .temp = (*temps)++ };
+            const char *name = NULL;
+            switch(bop.kind) {
+                case BOP_KIND_PLUS:  name = "add"; break;
+                case BOP_KIND_MINUS: name = "sub"; break;
+                case BOP_KIND_MULT:  name = "mul"; break;
+                case BOP_KIND_DIV:   name = "div"; break;
+                case BOP_KIND_POW:   name = "pow"; break;
+                case BOP_KIND_MOD:   name = "mod"; break;
                 case COUNT_BOP_KINDS:
-                default: {
-                    UNREACHABLE("Unknown binary operator kind");
-                }
-            }
-        } break;
-        case EXPR_KIND_UOP: {
-            double param = table_eval_expr(table, eb, expr->as.uop.param);
-            switch(expr->as.uop.kind) {
-                case UOP_KIND_MINUS:
-                    return -param;
                 default:
-                UNREACHABLE("Unknown unary operator kind");
+                    UNREACHABLE("Binary operator without an integer implementation");
             }
+            fprintf(stream, "%ssheet_%s_int(", result.temp == 0 ? "" : " && ", name);
+            aot_emit_int_operand(stream, lhs);
+            fprintf(stream, ", ");
+            aot_emit_int_operand(stream, rhs);
+            fprintf(stream, ", &t[%zu])", result.temp);
+            return result;
         }
+        case EXPR_KIND_UOP: {
+            if(expr->as.uop.kind != UOP_KIND_MINUS) UNREACHABLE("Unknown unary operator kind");
+            Aot_Int param = aot_emit_int_expr(stream, table, eb, expr->as.uop.param, temps);
+            Aot_Int result = { .temp = (*temps)++ };
+            fprintf(stream, "%ssheet_neg_int(", result.temp == 0 ? "" : " && ");
+            aot_emit_int_operand(stream, param);
+            fprintf(stream, ", &t[%zu])", result.temp);
+            return result;
+        }
+        default:
+            UNREACHABLE("Unknown expression kind");
     }
-
-    return 0;
 }
 
 /**
- * Returns the opposite direction.
- * LEFT <-> RIGHT, UP <-> DOWN
+ * Emits the function computing an integral formula template with integers for any cell
+ * holding it. The function stores the result into the cell and returns 1, or returns 0
+ * if the formula has to be computed with doubles.
  *
- * @param dir The direction to reverse.
- * @return The opposite direction.
+ * @param stream Output file stream.
+ * @param table Pointer to the table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param root Index of the root of the template.
  */
-Dir opposite_dir(Dir dir) 
+void aot_emit_int_template(FILE *stream, const Table *table, const Expr_Buffer *eb, Expr_Index root)
 {
-    switch(dir) {
-        case DIR_LEFT: return DIR_RIGHT;
-        case DIR_RIGHT: return DIR_LEFT;
-        case DIR_UP: return DIR_DOWN;
-        case DIR_DOWN: return DIR_UP;
-        default: {
-            UNREACHABLE("Unknown direction");
-        }
+    fprintf(stream, "static int sheet_int_%zu(double *v, long long *n, unsigned char *integral, long long origin, size_t cell)\n", root);
+    fprintf(stream, "{\n");
+    size_t cells = 0;
+    size_t temps = aot_int_temps(eb, root, &cells);
+    if(cells == 0) fprintf(stream, "    (void) origin;\n");
+    if(temps > 0) {
+        fprintf(stream, "    long long t[%zu];\n", temps);
+        fprintf(stream, "    if(!(");
     }
+    temps = 0;
+    Aot_Int result = aot_emit_int_expr(stream, table, eb, root, &temps);
+    if(temps > 0) fprintf(stream, ")) return 0;\n");
+    fprintf(stream, "    return sheet_set_int(v, n, integral, cell, ");
+    aot_emit_int_operand(stream, result);
+    fprintf(stream, ");\n");
+    fprintf(stream, "}\n\n");
 }
 
 /**
- * Returns the cell index of a neighboring cell in the specified direction.
+ * Emits a text cell as a C string literal.
  *
- * @param index The starting cell index.
- * @param dir The direction to move.
- * @return The new cell index.
+ * @param stream Output file stream.
+ * @param text The text of the cell.
  */
-Cell_Index nbor_in_dir(Cell_Index index, Dir dir) 
+void aot_emit_text(FILE *stream, String_View text)
 {
-    switch(dir) {
-        case DIR_LEFT:
-            index.col --;
-            break;
-        case DIR_RIGHT:
-            index.col ++;
-            break;
-        case DIR_UP:
-            index.row --;
-            break;
-        case DIR_DOWN:
-            index.row ++;
-            break;
-        default: {
-            UNREACHABLE("Unknown direction");
+    fputc('"', stream);
+    for(size_t i = 0; i < text.count; ++i) {
+        char c = text.data[i];
+        if(c == '"' || c == '\\') {
+            fprintf(stream, "\\%c", c);
+        } else if(isprint((unsigned char) c)) {
+            fputc(c, stream);
+        } else {
+            fprintf(stream, "\\%03o", (unsigned char) c);
+        }
+    }
+    fputc('"', stream);
+}
+
+/**
+ * Emits a standalone C program computing every formula cell of an evaluated table.
+ * The formulas are emitted as straight-line code in topological order. The program
+ * reads the values of the number cells from stdin in row-major order, keeping the
+ * values of the sheet for the missing ones, and renders the table to stdout.
+ * Like the interpreter, the program keeps the integers exact: integral formulas
+ * are computed with 64-bit integers first and fall back to doubles.
+ *
+ * @param stream Output file stream.
+ * @param table Pointer to the evaluated table structure.
+ * @param eb Pointer to the expression buffer.
+ * @param graph Pointer to the dependency graph of the table.
+ */
+void aot_emit_table(FILE *stream, Table *table, Expr_Buffer *eb, const Dep_Graph *graph)
+{
+    size_t cells_count = table->rows * table->cols;
+
+    fprintf(stream, "// Generated by excel-cli from %s. Do not edit.\n", table->file_path);
+    fprintf(stream, "#include <stdio.h>\n");
+    fprintf(stream, "#include <stdlib.h>\n");
+    fprintf(stream, "#include <string.h>\n");
+    fprintf(stream, "#include <errno.h>\n");
+    fprintf(stream, "#include <math.h>\n\n");
+    fprintf(stream, "#define SHEET_ROWS %zu\n", table->rows);
+    fprintf(stream, "#define SHEET_COLS %zu\n\n", table->cols);
+
+    fprintf(stream, "// Text cells of the sheet, NULL for the numeric ones\n");
+    fprintf(stream, "static const char *const sheet_texts[SHEET_ROWS * SHEET_COLS] = {\n");
+    for(size_t i = 0; i < cells_count; ++i) {
+        fprintf(stream, "    ");
+        if(table_kind(table, i) == CELL_KIND_TEXT) {
+            aot_emit_text(stream, table_text(table, i));
+        } else {
+            fprintf(stream, "NULL");
+        }
+        fprintf(stream, ",\n");
+    }
+    fprintf(stream, "};\n\n");
+
+    fprintf(stream, "// Input cells of the sheet in row-major order\n");
+    fprintf(stream, "static const size_t sheet_inputs[] = {");
+    size_t inputs_count = 0;
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(table_kind(table, i) == CELL_KIND_NUMBER) {
+            fprintf(stream, "%s%zu,", inputs_count % 16 == 0 ? "\n    " : " ", i);
+            inputs_count += 1;
         }
     }
+    if(inputs_count == 0) fprintf(stream, "0");
+    fprintf(stream, "\n};\n");
+    fprintf(stream, "#define SHEET_INPUTS %zu\n\n", inputs_count);
+
+    fprintf(stream, "// Values of the cells, initialized with the input values of the sheet\n");
+    fprintf(stream, "static double sheet_values[SHEET_ROWS * SHEET_COLS] = {\n");
+    for(size_t i = 0; i < cells_count; ++i) {
+        fprintf(stream, "    ");
+        aot_emit_number(stream, table_kind(table, i) == CELL_KIND_NUMBER ? table_number(table, i) : 0.0);
+        fprintf(stream, ",\n");
+    }
+    fprintf(stream, "};\n\n");
+
+    // Only the integer input cells are initialized, C forbids empty initializers
+    size_t integers_count = 0;
+    fprintf(stream, "// Exact values of the integer cells, flagged in sheet_integral\n");
+    fprintf(stream, "static long long sheet_integers[SHEET_ROWS * SHEET_COLS] = {\n");
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(table_kind(table, i) != CELL_KIND_NUMBER || table_type(table, i) != VALUE_TYPE_INT) continue;
+        fprintf(stream, "    [%zu] = ", i);
+        aot_emit_integer(stream, table_integer(table, i));
+        fprintf(stream, ",\n");
+        integers_count += 1;
+    }
+    if(integers_count == 0) fprintf(stream, "    0\n");
+    fprintf(stream, "};\n");
+    fprintf(stream, "static unsigned char sheet_integral[SHEET_ROWS * SHEET_COLS] = {\n");
+    for(size_t i = 0; i < cells_count; ++i) {
+        if(table_kind(table, i) != CELL_KIND_NUMBER || table_type(table, i) != VALUE_TYPE_INT) continue;
+        fprintf(stream, "    [%zu] = 1,\n", i);
+    }
+    if(integers_count == 0) fprintf(stream, "    0\n");
+    fprintf(stream, "};\n\n");
+
+    // The errors are encoded and decoded as by error_value and value_error
+    fprintf(stream, "// Errors are quiet NaNs holding the kind of the error in their payload\n");
+    fprintf(stream, "static double sheet_error(unsigned long long kind)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    unsigned long long bits = 0x%016llXULL | kind;\n", (unsigned long long) ERROR_NAN_BITS);
+    fprintf(stream, "    double value;\n");
+    fprintf(stream, "    memcpy(&value, &bits, sizeof(value));\n");
+    fprintf(stream, "    return value;\n");
+    fprintf(stream, "}\n\n");
+
+    // The same semantics as vm_div, vm_pow and vm_mod
+    fprintf(stream, "double sheet_div(double lhs, double rhs)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    if(isnan(lhs)) return lhs;\n");
+    fprintf(stream, "    if(rhs == 0.0) return sheet_error(%d);\n", (int) ERROR_KIND_DIV0);
+    fprintf(stream, "    return lhs / rhs;\n");
+    fprintf(stream, "}\n\n");
+    fprintf(stream, "static double sheet_bin_pow(double num, long long n)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    if(n == 0) return 1.0;\n");
+    fprintf(stream, "    if(n < 0) return 1.0 / (num * sheet_bin_pow(num, -(n + 1)));\n");
+    fprintf(stream, "    if(n %% 2 == 0) {\n");
+    fprintf(stream, "        double tmp = sheet_bin_pow(num, n / 2);\n");
+    fprintf(stream, "        return tmp*tmp;\n");
+    fprintf(stream, "    }\n");
+    fprintf(stream, "    return num * sheet_bin_pow(num, n - 1);\n");
+    fprintf(stream, "}\n\n");
+    fprintf(stream, "double sheet_pow(double num, double n)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    if(isnan(num)) return num;\n");
+    fprintf(stream, "    if(isnan(n)) return n;\n");
+    fprintf(stream, "    if(num == 0.0 && n <= -1.0) return sheet_error(%d);\n", (int) ERROR_KIND_DIV0);
+    fprintf(stream, "    if(n > -9223372036854775808.0 && n < 9223372036854775808.0) return sheet_bin_pow(num, (long long) n);\n");
+    fprintf(stream, "    return pow(num, trunc(n));\n");
+    fprintf(stream, "}\n\n");
+    fprintf(stream, "double sheet_mod(double lhs, double rhs)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    if(isnan(lhs)) return lhs;\n");
+    fprintf(stream, "    if(isnan(rhs)) return rhs;\n");
+    fprintf(stream, "    if(trunc(rhs) == 0.0) return sheet_error(%d);\n", (int) ERROR_KIND_DIV0);
+    fprintf(stream, "    return fmod(trunc(lhs), trunc(rhs)) + 0.0;\n");
+    fprintf(stream, "}\n\n");
+
+    // The same semantics as vm_add_int and the other integer operations
+    fprintf(stream, "// Integer operations, they fail on overflow and the formula is computed with doubles then\n");
+    fprintf(stream, "int sheet_add_int(long long lhs, long long rhs, long long *out) { return !__builtin_add_overflow(lhs, rhs, out); }\n");
+    fprintf(stream, "int sheet_sub_int(long long lhs, long long rhs, long long *out) { return !__builtin_sub_overflow(lhs, rhs, out); }\n");
+    fprintf(stream, "int sheet_mul_int(long long lhs, long long rhs, long long *out) { return !__builtin_mul_overflow(lhs, rhs, out); }\n\n");
+    fprintf(stream, "int sheet_div_int(long long lhs, long long rhs, long long *out)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    if(rhs == 0 || (lhs == -9223372036854775807LL - 1 && rhs == -1) || lhs %% rhs != 0) return 0;\n");
+    fprintf(stream, "    *out = lhs / rhs;\n");
+    fprintf(stream, "    return 1;\n");
+    fprintf(stream, "}\n\n");
+    fprintf(stream, "int sheet_pow_int(long long lhs, long long rhs, long long *out)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    if(rhs < 0) return 0;\n");
+    fprintf(stream, "    long long result = 1;\n");
+    fprintf(stream, "    while(rhs > 0) {\n");
+    fprintf(stream, "        if((rhs & 1) && !sheet_mul_int(result, lhs, &result)) return 0;\n");
+    fprintf(stream, "        rhs >>= 1;\n");
+    fprintf(stream, "        if(rhs > 0 && !sheet_mul_int(lhs, lhs, &lhs)) return 0;\n");
+    fprintf(stream, "    }\n");
+    fprintf(stream, "    *out = result;\n");
+    fprintf(stream, "    return 1;\n");
+    fprintf(stream, "}\n\n");
+    fprintf(stream, "int sheet_mod_int(long long lhs, long long rhs, long long *out)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    if(rhs == 0) return 0;\n");
+    fprintf(stream, "    *out = rhs == -1 ? 0 : lhs %% rhs;\n");
+    fprintf(stream, "    return 1;\n");
+    fprintf(stream, "}\n\n");
+    fprintf(stream, "int sheet_neg_int(long long param, long long *out)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    if(param == -9223372036854775807LL - 1) return 0;\n");
+    fprintf(stream, "    *out = -param;\n");
+    fprintf(stream, "    return 1;\n");
+    fprintf(stream, "}\n\n");
+    fprintf(stream, "// Loads a cell into the integer code, failing if the cell is not an integer\n");
+    fprintf(stream, "int sheet_int(const long long *n, const unsigned char *integral, long long cell, long long *out)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    if(!integral[cell]) return 0;\n");
+    fprintf(stream, "    *out = n[cell];\n");
+    fprintf(stream, "    return 1;\n");
+    fprintf(stream, "}\n\n");
+    fprintf(stream, "// Stores the result of the integer code into a cell\n");
+    fprintf(stream, "int sheet_set_int(double *v, long long *n, unsigned char *integral, size_t cell, long long value)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    n[cell] = value;\n");
+    fprintf(stream, "    v[cell] = (double) value;\n");
+    fprintf(stream, "    integral[cell] = 1;\n");
+    fprintf(stream, "    return 1;\n");
+    fprintf(stream, "}\n\n");
+
+    // The integer code is emitted once per integral formula template, for all the cells holding it
+    bool *emitted = calloc(eb->count, sizeof(*emitted));
+    for(size_t k = 0; k < graph->order_count; ++k) {
+        Expr_Index root = table_formula(table, graph->order[k])->index;
+        if(emitted[root] || expr_buffer_at(eb, root)->type != VALUE_TYPE_INT) continue;
+        aot_emit_int_template(stream, table, eb, root);
+        emitted[root] = true;
+    }
+    free(emitted);
+
+    // Emit the formula cells in the topological order of the graph. The statements are split
+    // into chunks of AOT_CHUNK_SIZE functions which C compilers optimize much faster than
+    // a single huge function.
+    size_t chunks_count = 0;
+    for(size_t k = 0; k < graph->order_count; ++k) {
+        size_t index = graph->order[k];
+        const Cell_Expr *expr = &*table_formula(table, index);
+
+        if(k % AOT_CHUNK_SIZE == 0) {
+            if(chunks_count > 0) fprintf(stream, "}\n\n");
+            fprintf(stream, "static void sheet_eval_%zu(double *v, long long *n, unsigned char *integral)\n", chunks_count++);
+            fprintf(stream, "{\n");
+            fprintf(stream, "    (void) n;\n");
+            fprintf(stream, "    (void) integral;\n");
+        }
 
-    return index;
+        if(expr_buffer_at(eb, expr->index)->type == VALUE_TYPE_INT) {
+            // The integer code sets the cell and the doubles are used only if it fails
+            fprintf(stream, "    if(!sheet_int_%zu(v, n, integral, %td, %zu)) integral[%zu] = 0, ", expr->index,
+                expr->offset.row * (ptrdiff_t) table->cols + expr->offset.col, index, index);
+        } else {
+            fprintf(stream, "    ");
+        }
+        fprintf(stream, "v[%zu] = ", index);
+        aot_emit_expr(stream, table, eb, expr->index, expr->offset);
+        Cell_Location location = table_location(table, index);
+        fprintf(stream, "; // %s:%zu:%zu\n", table->file_path, location.file_row, location.file_col);
+    }
+    if(chunks_count > 0) fprintf(stream, "}\n\n");
+
+    fprintf(stream, "// Computes every formula cell of the sheet from the values of its input cells.\n");
+    fprintf(stream, "// The cells flagged in `integral` hold integers, whose exact values are in `n`.\n");
+    fprintf(stream, "void sheet_eval(double *v, long long *n, unsigned char *integral)\n");
+    fprintf(stream, "{\n");
+    if(chunks_count == 0) fprintf(stream, "    (void) v;\n    (void) n;\n    (void) integral;\n");
+    for(size_t i = 0; i < chunks_count; ++i) {
+        fprintf(stream, "    sheet_eval_%zu(v, n, integral);\n", i);
+    }
+    fprintf(stream, "}\n\n");
+
+    fprintf(stream, "#ifndef SHEET_NO_MAIN\n");
+    fprintf(stream, "// Reads an input cell, as an integer if it is one like in the sheet\n");
+    fprintf(stream, "static int sheet_read(size_t cell, const char *token)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    char *end = NULL;\n");
+    fprintf(stream, "    errno = 0;\n");
+    fprintf(stream, "    long long integer = strtoll(token, &end, 10);\n");
+    fprintf(stream, "    sheet_integral[cell] = end != token && *end == '\\0' && errno != ERANGE;\n");
+    fprintf(stream, "    if(sheet_integral[cell]) {\n");
+    fprintf(stream, "        sheet_integers[cell] = integer;\n");
+    fprintf(stream, "        sheet_values[cell] = (double) integer;\n");
+    fprintf(stream, "        return 1;\n");
+    fprintf(stream, "    }\n");
+    fprintf(stream, "    sheet_values[cell] = strtod(token, &end);\n");
+    fprintf(stream, "    return end != token && *end == '\\0';\n");
+    fprintf(stream, "}\n\n");
+    fprintf(stream, "// Formats a numeric cell like excel-cli renders it\n");
+    fprintf(stream, "static int sheet_format(char *buffer, size_t size, size_t cell)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    if(sheet_integral[cell]) return snprintf(buffer, size, \"%%lld.000000\", sheet_integers[cell]);\n");
+    fprintf(stream, "    unsigned long long bits;\n");
+    fprintf(stream, "    memcpy(&bits, &sheet_values[cell], sizeof(bits));\n");
+    fprintf(stream, "    if((bits & 0x%016llXULL) == 0x%016llXULL) {\n",
+        (unsigned long long) ERROR_NAN_MASK, (unsigned long long) ERROR_NAN_BITS);
+    fprintf(stream, "        switch(bits & 0xFF) {\n");
+    for(Error_Kind kind = ERROR_KIND_NONE + 1; kind < COUNT_ERROR_KINDS; ++kind) {
+        fprintf(stream, "            case %d: return snprintf(buffer, size, \"%s\");\n", (int) kind, error_kind_as_cstr(kind));
+    }
+    fprintf(stream, "        }\n");
+    fprintf(stream, "    }\n");
+    fprintf(stream, "    return snprintf(buffer, size, \"%%lf\", sheet_values[cell]);\n");
+    fprintf(stream, "}\n\n");
+    fprintf(stream, "int main(void)\n");
+    fprintf(stream, "{\n");
+    fprintf(stream, "    char token[512];\n");
+    fprintf(stream, "    for(size_t i = 0; i < SHEET_INPUTS; ++i) {\n");
+    fprintf(stream, "        if(scanf(\"%%511s\", token) != 1 || !sheet_read(sheet_inputs[i], token)) break;\n");
+    fprintf(stream, "    }\n\n");
+    fprintf(stream, "    sheet_eval(sheet_values, sheet_integers, sheet_integral);\n\n");
+    fprintf(stream, "    size_t widths[SHEET_COLS] = {0};\n");
+    fprintf(stream, "    for(size_t i = 0; i < SHEET_ROWS * SHEET_COLS; ++i) {\n");
+    fprintf(stream, "        size_t width = sheet_texts[i] ? strlen(sheet_texts[i]) : (size_t) sheet_format(NULL, 0, i);\n");
+    fprintf(stream, "        if(widths[i %% SHEET_COLS] < width) widths[i %% SHEET_COLS] = width;\n");
+    fprintf(stream, "    }\n\n");
+    fprintf(stream, "    for(size_t i = 0; i < SHEET_ROWS * SHEET_COLS; ++i) {\n");
+    fprintf(stream, "        size_t col = i %% SHEET_COLS;\n");
+    fprintf(stream, "        if(!sheet_texts[i]) sheet_format(token, sizeof(token), i);\n");
+    fprintf(stream, "        int n = printf(\"%%s\", sheet_texts[i] ? sheet_texts[i] : token);\n");
+    fprintf(stream, "        printf(\"%%*s\", (int) (widths[col] - n), \"\");\n");
+    fprintf(stream, "        printf(col < SHEET_COLS - 1 ? \" | \" : \"\\n\");\n");
+    fprintf(stream, "    }\n\n");
+    fprintf(stream, "    return 0;\n");
+    fprintf(stream, "}\n");
+    fprintf(stream, "#endif // SHEET_NO_MAIN\n");
 }
 
 /**
- * Moves an expression in a specified direction.
- * Creates a new expression with adjusted cell references.
+ * Renders the evaluated table into the output file and to stdout.
+ * Every column is padded to the width of its widest cell.
  *
+ * @param out_file Output file stream.
  * @param table Pointer to the table structure.
- * @param cell_index Index of the current cell.
- * @param eb Pointer to the expression buffer.
- * @param root Index of the root expression to move.
- * @param dir Direction to move the expression.
- * @return Index of the new, moved expression.
+ * @param shown The columns to render, NULL to render all of them.
  */
-Expr_Index move_expr_in_dir(Table *table, Cell_Index cell_index, Expr_Buffer *eb, Expr_Index root, Dir dir) 
+void render_table(FILE *out_file, Table *table, const bool *shown)
 {
-    Cell *cell = table_cell_at(table, cell_index);
+    // The separator follows every rendered column but the last one
+    size_t last_shown = 0;
+    for(size_t col = 0; col < table->cols; ++col) {
+        if(shown == NULL || shown[col]) last_shown = col;
+    }
 
-    switch (expr_buffer_at(eb, root)->kind) {
-        case EXPR_KIND_NUMBER:
-            return root;
-        case EXPR_KIND_CELL: {
+    // Estimate column widths, row by row to read the cells in the order they are stored
+    size_t *col_widths = calloc(table->cols + 1, sizeof(size_t));
+    {
+        for (size_t row = 0; row < table->rows; ++row) {
+            for (size_t col = 0; col < table->cols; ++col) {
+                if(shown != NULL && !shown[col]) continue;
+                Cell_Index cell_index = {
+                    .row = row,
+                    .col = col,
+                };
 
-            Expr_Index new_index = expr_buffer_alloc(eb); 
-            {
-                Expr *new_expr = expr_buffer_at(eb, new_index);
-                new_expr->kind = EXPR_KIND_CELL;
-                new_expr->as.cell = nbor_in_dir(expr_buffer_at(eb, root)->as.cell, dir);
+                size_t cell = table_cell_at(table, cell_index);
+                size_t width = 0;
+                switch (table_kind(table, cell)) {
+                case CELL_KIND_TEXT:
+                    width = table_text(table, cell).count;
+                    break;
+                case CELL_KIND_NUMBER:
+                case CELL_KIND_EXPR: {
+                    int n = table_snprint_number(NULL, 0, table, cell);
+                    assert(n >= 0);
+                    width = (size_t) n;
+                } break;
+                case CELL_KIND_CLONE:
+                    UNREACHABLE("Cell should never be a clone after the evaluation");
+                    break;
+                default:
+                    UNREACHABLE("");
+                    break;
+                }
 
-                new_expr->file_path = table->file_path;
-                new_expr->file_row = cell->file_row;
-                new_expr->file_col = cell->file_col;
+                if (col_widths[col] < width) {
+                    col_widths[col] = width;
+                }
             }
-            return new_index;
-        } break;
-        case EXPR_KIND_BOP: {
-            Expr_Bop bop = {0};
+        }
+    }
 
-            {
-                Expr *root_expr = expr_buffer_at(eb, root);
-                bop = root_expr->as.bop;
-            }
+    // Render the table
+    for(size_t row = 0; row < table->rows; ++row) {
+        for(size_t col = 0; col < table->cols; ++col) {
+            if(shown != NULL && !shown[col]) continue;
 
+            Cell_Index cell_index = {
+                .col = col,
+                .row = row,
+            };
 
-            bop.lhs = move_expr_in_dir(table, cell_index, eb, bop.lhs, dir);
-            bop.rhs = move_expr_in_dir(table, cell_index, eb, bop.rhs, dir);
+            size_t cell = table_cell_at(table, cell_index);
+            int printn = 0;
 
-            Expr_Index new_index = expr_buffer_alloc(eb);
-            
-            {
-                Expr *new_expr = expr_buffer_at(eb, new_index);
-                new_expr->kind = EXPR_KIND_BOP;
-                new_expr->as.bop = bop;
-                new_expr->file_path = table->file_path;
-                new_expr->file_col = cell->file_col;
-                new_expr->file_row = cell->file_row;
-            }
-        
-            return new_index;
-        } break;
-        case EXPR_KIND_UOP: {
-            Expr_Uop uop = {0};
-            {
-                Expr *root_expr = expr_buffer_at(eb, root);
-                uop = root_expr->as.uop;
+            switch(table_kind(table, cell)) {
+                case CELL_KIND_TEXT: 
+                    printn = fprintf(out_file, SV_Fmt, SV_Arg(table_text(table, cell)));
+                    fprintf(stdout, SV_Fmt, SV_Arg(table_text(table, cell)));
+                    break;
+                case CELL_KIND_NUMBER:
+                case CELL_KIND_EXPR: {
+                    // Wide enough for any double printed with %lf
+                    char number[512];
+                    table_snprint_number(number, sizeof(number), table, cell);
+                    printn = fprintf(out_file, "%s", number);
+                    fprintf(stdout, "%s", number);
+                } break;
+                case CELL_KIND_CLONE:
+                    UNREACHABLE("Cell should never be a clone after evalution");
+                    break;
+                default:
+                    UNREACHABLE("Unknown cell kind");
+                    break;
             }
 
-            uop.param = move_expr_in_dir(table, cell_index, eb, uop.param, dir);
-            Expr_Index new_index = expr_buffer_alloc(eb);
-            {
-                Expr *new_expr = expr_buffer_at(eb, new_index);
-                new_expr->kind = EXPR_KIND_UOP;
-                new_expr->as.uop = uop;
-                new_expr->file_path = table->file_path;
-                new_expr->file_col = cell->file_col;
-                new_expr->file_row = cell->file_row;
-            }
+            assert(0 <= printn);
+            assert((size_t) printn <= col_widths[col]);
+            fprintf(out_file, "%*s", (int) (col_widths[col] - printn), "");
+            fprintf(stdout, "%*s", (int) (col_widths[col] - printn), "");
 
-            return new_index;
-        } break;
-        default: {
-            UNREACHABLE("Unknown expression kind");
+            if(col < last_shown) {
+                fprintf(out_file, " | ");
+                fprintf(stdout, " | ");
+            }
         }
+
+        fprintf(out_file, "\n");
+        fprintf(stdout, "\n");
     }
+
+    free(col_widths);
 }
 
 /**
- * Evaluates a cell in the table.
- * Handles different cell types and their evaluation rules.
- * Detects circular dependencies.
+ * Renders the requested cells of the evaluated table into the output file and to stdout,
+ * one `<cell> | <value>` line per cell in the order they were requested.
  *
+ * @param out_file Output file stream.
  * @param table Pointer to the table structure.
- * @param eb Pointer to the expression buffer.
- * @param cell_index Index of the cell to evaluate.
+ * @param ranges The requested ranges of cells, each in row-major order.
+ * @param ranges_count Number of the ranges.
  */
-void table_eval_cell(Table *table, Expr_Buffer *eb, Cell_Index cell_index) 
+void render_cells(FILE *out_file, Table *table, const Cell_Range *ranges, size_t ranges_count)
 {
-    Cell *cell = table_cell_at(table, cell_index);
-
-    switch(cell->kind) {
-        case CELL_KIND_TEXT:
-        case CELL_KIND_NUMBER:
-            cell->status = EVALUATED;
-            break;
-        case CELL_KIND_EXPR: { 
-            if(cell->status == INPROGRESS) {
-                fprintf(stderr, "%s:%zu:%zu: ERROR: circular dependency is detected!\n", table->file_path, cell->file_row, cell->file_col);
-                exit(1);
-            }
-
-            if(cell->status == UNEVALUATED) {
-                cell->status = INPROGRESS;
-                cell->as.expr.value = table_eval_expr(table, eb, cell->as.expr.index);
-                cell->status = EVALUATED;
-            }
-        } break;
+    // Name of a cell: the column letter and the row number
+    char name[32];
+
+    // Estimate the width of the names
+    size_t name_width = 0;
+    for(size_t i = 0; i < ranges_count; ++i) {
+        int n = snprintf(name, sizeof(name), "%c%zu", (char) ('A' + ranges[i].last.col), ranges[i].last.row);
+        assert(n >= 0);
+        if(name_width < (size_t) n) name_width = (size_t) n;
+    }
 
-        case CELL_KIND_CLONE: {
-            if(cell->status == INPROGRESS) {
-                fprintf(stderr, "%s:%zu:%zu: ERROR: circular dependency is detected!\n", table->file_path, cell->file_row, cell->file_col);
-                exit(1);
-            }
+    for(size_t i = 0; i < ranges_count; ++i) {
+        for(size_t row = ranges[i].first.row; row <= ranges[i].last.row; ++row) {
+            for(size_t col = ranges[i].first.col; col <= ranges[i].last.col; ++col) {
+                Cell_Index cell_index = {
+                    .col = col,
+                    .row = row,
+                };
 
-            if(cell->status == UNEVALUATED) {
-                cell->status = INPROGRESS;
-                
-                Dir dir = cell->as.clone;
-                Cell_Index nbor_index = nbor_in_dir(cell_index, dir);
-                
-                if(nbor_index.row >= table->rows || nbor_index.col >= table->cols) {
-                    fprintf(stderr, "%s:%zu:%zu: ERROR: trying to clone a cell outside of the table\n", table->file_path, cell->file_row, cell->file_col);
-                    exit(1);
+                snprintf(name, sizeof(name), "%c%zu", (char) ('A' + col), row);
+                fprintf(out_file, "%-*s | ", (int) name_width, name);
+                fprintf(stdout, "%-*s | ", (int) name_width, name);
+
+                size_t cell = table_cell_at(table, cell_index);
+                switch(table_kind(table, cell)) {
+                    case CELL_KIND_TEXT:
+                        fprintf(out_file, SV_Fmt"\n", SV_Arg(table_text(table, cell)));
+                        fprintf(stdout, SV_Fmt"\n", SV_Arg(table_text(table, cell)));
+                        break;
+                    case CELL_KIND_NUMBER:
+                    case CELL_KIND_EXPR: {
+                        // Wide enough for any double printed with %lf
+                        char number[512];
+                        table_snprint_number(number, sizeof(number), table, cell);
+                        fprintf(out_file, "%s\n", number);
+                        fprintf(stdout, "%s\n", number);
+                    } break;
+                    case CELL_KIND_CLONE:
+                        UNREACHABLE("Cell should never be a clone after evalution");
+                        break;
+                    default:
+                        UNREACHABLE("Unknown cell kind");
+                        break;
                 }
-                
-                table_eval_cell(table, eb, nbor_index);
-                
-                Cell *nbor = table_cell_at(table, nbor_index);
-                cell->kind = nbor->kind;
-                cell->as = nbor->as;
-
-                if(cell->kind == CELL_KIND_EXPR) {
-                    cell->as.expr.index = move_expr_in_dir(table, cell_index, eb, cell->as.expr.index, opposite_dir(dir));
-                    cell->as.expr.value = table_eval_expr(table, eb, cell->as.expr.index);
-                }
-
-                cell->status = EVALUATED;
-            } else {
-               UNREACHABLE("Evaluated cloens are an absurd. When a clone cell is evaluated it becomes its neighbor kind");
-                exit(1);
             }
-        } break;
+        }
     }
 }
 
 /**
- * Takes the first n characters from a string and returns them as a new null-terminated string.
- * Helper function for displaying text values.
+ * Counts the evaluated cells holding errors and summarizes them on stderr,
+ * locating the first cell of every kind of error.
  *
- * @param input The input string.
- * @param count Number of characters to take.
- * @return A newly allocated string containing the first n characters of input, or NULL on error.
+ * @param table Pointer to the evaluated table.
+ * @return The number of the cells holding errors.
  */
-const char* sv_take_first_n(const char* input, size_t count) {
-    if (input == NULL) {
-        return NULL;
-    }
-    
-    size_t input_length = strlen(input);
-    
-    if (count > input_length) {
-        count = input_length;
+size_t table_report_errors(const Table *table)
+{
+    size_t counts[COUNT_ERROR_KINDS] = {0};
+    size_t firsts[COUNT_ERROR_KINDS] = {0};
+    size_t errors_count = 0;
+
+    for(size_t i = 0; i < table->rows * table->cols; ++i) {
+        Cell_Kind kind = table_kind(table, i);
+        if(kind != CELL_KIND_NUMBER && (kind != CELL_KIND_EXPR || !table_evaluated(table, i))) continue;
+        if(table_type(table, i) != VALUE_TYPE_DOUBLE) continue;
+
+        Error_Kind error = value_error(table_number(table, i));
+        if(error == ERROR_KIND_NONE) continue;
+        if(counts[error] == 0) firsts[error] = i;
+        counts[error] += 1;
+        errors_count += 1;
     }
-    
-    char* result = (char*)malloc((count + 1) * sizeof(char));
-    if (result == NULL) {
-        return NULL; // Memory allocation failed
+    if(errors_count == 0) return 0;
+
+    fprintf(stderr, "WARNING: %zu cell%s evaluate%s to errors:", errors_count, errors_count == 1 ? "" : "s", errors_count == 1 ? "s" : "");
+    const char *separator = "";
+    for(size_t kind = ERROR_KIND_NONE + 1; kind < COUNT_ERROR_KINDS; ++kind) {
+        if(counts[kind] == 0) continue;
+        fprintf(stderr, "%s %zu %s", separator, counts[kind], error_kind_as_cstr((Error_Kind) kind));
+        separator = ",";
     }
-    
-    for (size_t i = 0; i < count; i++) {
-        result[i] = input[i];
+    fprintf(stderr, "\n");
+
+    for(size_t kind = ERROR_KIND_NONE + 1; kind < COUNT_ERROR_KINDS; ++kind) {
+        if(counts[kind] == 0) continue;
+        Cell_Location location = table_location(table, firsts[kind]);
+        fprintf(stderr, "%s:%zu:%zu: NOTE: the first %s is in the cell %c%zu\n", table->file_path, location.file_row, location.file_col,
+            error_kind_as_cstr((Error_Kind) kind), (char) ('A' + firsts[kind] % table->cols), firsts[kind] / table->cols);
     }
-    
-    result[count] = '\0';
-    
-    return result;
+
+    return errors_count;
 }
 
 /**
@@ -1211,14 +6918,113 @@ int main(int argc, char **argv)
 {
     clock_t start_time = clock();
 
-    if(argc < 3) {
+    const char *input_file_path = NULL;
+    const char *output_file_path = NULL;
+    bool huge_pages = false;
+    bool jit = false;
+    bool compile = false;
+    const char *cache_dir = NULL;
+    const char *state_path = NULL;
+    const char *patch_path = NULL;
+    const char *cells_list = NULL;
+    const char *columns_list = NULL;
+    size_t jobs = 1;
+
+    int first_arg = 1;
+    if(argc > 1 && strcmp(argv[1], "compile") == 0) {
+        compile = true;
+        first_arg = 2;
+    }
+
+    for(int i = first_arg; i < argc; ++i) {
+        const char *arg = argv[i];
+        if(strcmp(arg, "--huge-pages") == 0) {
+            huge_pages = true;
+        } else if(strcmp(arg, "--jit") == 0) {
+            jit = true;
+        } else if(strcmp(arg, "--cache") == 0) {
+            if(i + 1 >= argc) {
+                print_usage(stderr);
+                fprintf(stderr, "ERROR: no directory is provided for %s\n", arg);
+                exit(1);
+            }
+            cache_dir = argv[++i];
+        } else if(strcmp(arg, "--state") == 0) {
+            if(i + 1 >= argc) {
+                print_usage(stderr);
+                fprintf(stderr, "ERROR: no file is provided for %s\n", arg);
+                exit(1);
+            }
+            state_path = argv[++i];
+        } else if(strcmp(arg, "--patch") == 0) {
+            if(i + 1 >= argc) {
+                print_usage(stderr);
+                fprintf(stderr, "ERROR: no file is provided for %s\n", arg);
+                exit(1);
+            }
+            patch_path = argv[++i];
+        } else if(strcmp(arg, "--cells") == 0) {
+            if(i + 1 >= argc) {
+                print_usage(stderr);
+                fprintf(stderr, "ERROR: no cells are provided for %s\n", arg);
+                exit(1);
+            }
+            cells_list = argv[++i];
+        } else if(strcmp(arg, "--columns") == 0) {
+            if(i + 1 >= argc) {
+                print_usage(stderr);
+                fprintf(stderr, "ERROR: no columns are provided for %s\n", arg);
+                exit(1);
+            }
+            columns_list = argv[++i];
+        } else if(strcmp(arg, "--jobs") == 0) {
+            char *end = NULL;
+            long long value = i + 1 < argc ? strtoll(argv[i + 1], &end, 10) : 0;
+            if(i + 1 >= argc || *end != '\0' || value < 1) {
+                print_usage(stderr);
+                fprintf(stderr, "ERROR: %s expects a positive number of threads\n", arg);
+                exit(1);
+            }
+            jobs = (size_t) value;
+            i += 1;
+        } else if(strncmp(arg, "--", 2) == 0) {
+            print_usage(stderr);
+            fprintf(stderr, "ERROR: unknown option %s\n", arg);
+            exit(1);
+        } else if(input_file_path == NULL) {
+            input_file_path = arg;
+        } else if(output_file_path == NULL) {
+            output_file_path = arg;
+        } else {
+            print_usage(stderr);
+            fprintf(stderr, "ERROR: unexpected argument %s\n", arg);
+            exit(1);
+        }
+    }
+
+    if(input_file_path == NULL || output_file_path == NULL) {
         print_usage(stderr);
         fprintf(stderr, "ERROR: input or output files are not provided\n");
         exit(1);
     }
 
-    const char *input_file_path = argv[1];
-    const char *output_file_path = argv[2];
+    if((patch_path != NULL && state_path == NULL) || (state_path != NULL && compile)) {
+        print_usage(stderr);
+        fprintf(stderr, "ERROR: --patch needs the --state of a previous run, compile supports neither\n");
+        exit(1);
+    }
+
+    if(cells_list != NULL && (state_path != NULL || compile)) {
+        print_usage(stderr);
+        fprintf(stderr, "ERROR: --cells supports neither --state nor compile\n");
+        exit(1);
+    }
+
+    if(columns_list != NULL && (cells_list != NULL || state_path != NULL || compile)) {
+        print_usage(stderr);
+        fprintf(stderr, "ERROR: --columns supports neither --cells, --state nor compile\n");
+        exit(1);
+    }
 
     size_t content_size = 0;
     char *content = read_csv(input_file_path, &content_size);
@@ -1234,138 +7040,165 @@ int main(int argc, char **argv)
         exit(1);
     }
 
-    char *dump_file_path = "out/dump.bin";
-    FILE *dump_file = fopen(dump_file_path, "w");
-    if(dump_file == NULL) {
-        fprintf(stderr, "ERROR: could not write to file %s: %s\n", dump_file_path, strerror(errno));
-        exit(1);
-    }
-
     String_View input = {
         .count = content_size,
         .data = content,
     };
 
-    Expr_Buffer eb = {0};
+    Expr_Buffer eb = {
+        .huge_pages = huge_pages,
+    };
     Table table = {
         .file_path = input_file_path,
     };
     Tmp_Cstr tc = {0};
+    Bytecode bc = {0};
 
-    estimate_table_size(input, &table.rows, &table.cols);
-    table.cells = malloc(sizeof(*table.cells) * table.rows * table.cols);
-    memset(table.cells, 0, sizeof(*table.cells) * table.rows * table.cols);
-    parse_table_from_content(&table, &eb, &tc, input);
+    Cache cache = {0};
+    char *cache_path = cache_dir ? cache_path_for(cache_dir, input) : NULL;
 
-    // Evaluate each cell
-    for(size_t row = 0; row < table.rows; ++row) {
-        for(size_t col = 0; col < table.cols; ++col) {
-            Cell_Index cell_index = {
-                .col = col,
-                .row = row,
-            };
+    if(cache_path == NULL || !cache_load(&cache, cache_path, &table, &eb, input)) {
+        estimate_table_size(input, &table.rows, &table.cols);
+        table_alloc(&table);
+        parse_table_from_content(&table, &eb, &tc, input);
 
-            table_eval_cell(&table, &eb, cell_index);
+        if(cache_path) {
+            cache_save(cache_path, &table, &eb, input);
         }
     }
 
-    // Estimate column widths
-    size_t *col_widths = malloc(sizeof(size_t) * table.cols);
-    {
-        for (size_t col = 0; col < table.cols; ++col) {
-            col_widths[col] = 0;
-            for (size_t row = 0; row < table.rows; ++row) {
-                Cell_Index cell_index = {
-                    .row = row,
-                    .col = col,
-                };
-
-                Cell *cell = table_cell_at(&table, cell_index);
-                size_t width = 0;
-                switch (cell->kind) {
-                case CELL_KIND_TEXT:
-                    width = cell->as.text.count;
-                    break;
-                case CELL_KIND_NUMBER: {
-                    int n = snprintf(NULL, 0, "%lf", cell->as.number);
-                    assert(n >= 0);
-                    width = (size_t) n;
-                } break;
-                case CELL_KIND_EXPR: {
-                    int n = snprintf(NULL, 0, "%lf", cell->as.expr.value);
-                    assert(n >= 0);
-                    width = (size_t) n;
-                } break;
-                case CELL_KIND_CLONE:
-                    UNREACHABLE("Cell should never be a clone after the evaluation");
-                    break;
-                default:
-                    UNREACHABLE("");
-                    break;
-                }
-
-                if (col_widths[col] < width) {
-                    col_widths[col] = width;
-                }
-            }
+    // Find the cells that changed since the state of the previous run was saved and
+    // apply the patch on top of them
+    char *patch_content = NULL;
+    bool *dirty = NULL;
+    State state = {0};
+    bool incremental = false;
+    if(state_path) {
+        dirty = calloc(table.rows * table.cols + 1, sizeof(*dirty));
+        if(dirty == NULL) {
+            fprintf(stderr, "ERROR: could not allocate the changed cells\n");
+            exit(1);
+        }
+        incremental = state_load(&state, state_path, &table);
+        if(incremental) {
+            table_diff_rows(&table, &state, input, dirty);
         }
     }
 
-    // Render the table
-    for(size_t row = 0; row < table.rows; ++row) {
-        for(size_t col = 0; col < table.cols; ++col) {
-            Cell_Index cell_index = {
-                .col = col,
-                .row = row,
-            };
+    if(patch_path) {
+        size_t patch_size = 0;
+        patch_content = read_csv(patch_path, &patch_size);
+        if(patch_content == NULL) {
+            fprintf(stderr, "ERROR: could not read file %s: %s\n", patch_path, strerror(errno));
+            exit(1);
+        }
 
-            Cell *cell = table_cell_at(&table, cell_index);
-            int printn = 0;
+        String_View patch = {
+            .count = patch_size,
+            .data = patch_content,
+        };
+        table_apply_patch(&table, &eb, &tc, patch_path, patch, dirty);
+    }
 
-            switch(cell->kind) {
-                case CELL_KIND_TEXT: 
-                    printn = fprintf(out_file, SV_Fmt, SV_Arg(cell->as.text));
-                    fprintf(stdout, SV_Fmt, SV_Arg(cell->as.text));
-                    break;
-                case CELL_KIND_NUMBER:
-                    printn = fprintf(out_file, "%lf", cell->as.number);
-                    fprintf(stdout, "%lf", cell->as.number);
-                    break;
-                case CELL_KIND_EXPR:
-                    printn = fprintf(out_file, "%lf", cell->as.expr.value);
-                    fprintf(stdout, "%lf", cell->as.expr.value);
-                    break;
-                case CELL_KIND_CLONE:
-                    UNREACHABLE("Cell should never be a clone after evalution");
-                    break;
-                default:
-                    UNREACHABLE("Unknown cell kind");
-                    break;
-            }
+    if(dirty) {
+        table_mark_dirty_clones(&table, dirty);
+    }
 
-            assert(0 <= printn);
-            assert((size_t) printn <= col_widths[col]);
-            fprintf(out_file, "%*s", (int) (col_widths[col] - printn), "");
-            fprintf(stdout, "%*s", (int) (col_widths[col] - printn), "");
+    if(jit) {
+        jit_compile_table(&table, &eb, &bc);
+    }
 
-            if(col < table.cols - 1) {
-                fprintf(out_file, " | ");
-                fprintf(stdout, " | ");
+    // Evaluate each cell in the order of their dependencies
+    Dep_Graph graph = {0};
+    table_resolve_clones(&table);
+
+    // Leave out the columns neither shown nor needed by the shown ones
+    bool *shown = NULL;
+    if(columns_list) {
+        shown = calloc(table.cols + 1, sizeof(*shown));
+        table_parse_columns(&table, columns_list, shown);
+        table_project_columns(&table, &eb, &bc, shown);
+    }
+    // The values of the formulas are stored over their indices from now on
+    table_order_formulas(&table);
+
+    Cell_Range *ranges = NULL;
+    size_t ranges_count = 0;
+    size_t recomputed = table.rows * table.cols;
+    if(cells_list) {
+        // Evaluate only the requested cells and what they depend on, with the cycles
+        // among them reported up front so the order of the list does not matter
+        ranges = table_parse_ranges(&table, &tc, cells_list, &ranges_count);
+        size_t *cells = NULL;
+        size_t cells_count = 0;
+        size_t cells_capacity = 0;
+        for(size_t i = 0; i < ranges_count; ++i) {
+            for(size_t row = ranges[i].first.row; row <= ranges[i].last.row; ++row) {
+                for(size_t col = ranges[i].first.col; col <= ranges[i].last.col; ++col) {
+                    if(cells_count >= cells_capacity) {
+                        cells_capacity = cells_capacity == 0 ? 16 : cells_capacity * 2;
+                        cells = realloc(cells, sizeof(*cells) * cells_capacity);
+                    }
+                    cells[cells_count++] = row * table.cols + col;
+                }
+            }
+        }
+        table_report_cone_cycles(&table, &eb, &bc, cells, cells_count);
+        free(cells);
+
+        for(size_t i = 0; i < ranges_count; ++i) {
+            for(size_t row = ranges[i].first.row; row <= ranges[i].last.row; ++row) {
+                for(size_t col = ranges[i].first.col; col <= ranges[i].last.col; ++col) {
+                    Cell_Index cell_index = { .row = row, .col = col };
+                    table_eval_cell(&table, &eb, &bc, cell_index);
+                }
             }
         }
+    } else if(incremental) {
+        recomputed = table_eval_dirty(&table, &eb, &bc, &state, dirty);
+    } else {
+        dep_graph_build(&graph, &table, &eb, &bc);
+        if(jobs <= 1 || graph.linear_cells * 2 >= graph.order_count) {
+            // Mostly linear runs, whose scans use the threads
+            table_eval_graph(&table, &eb, &bc, &graph, jobs);
+        } else if(dep_graph_is_up_left(&graph, table.cols)) {
+            table_eval_wavefront(&table, &eb, &bc, &graph, jobs);
+        } else {
+            table_eval_graph_parallel(&table, &eb, &bc, &graph, jobs);
+        }
+    }
 
-        fprintf(out_file, "\n");
-        fprintf(stdout, "\n");
+    // The state follows the input, not the patches applied on top of it
+    if(state_path && patch_path == NULL && recomputed > 0) {
+        state_save(state_path, &table, &eb, &bc, input);
     }
 
+    size_t errors_count = table_report_errors(&table);
+    if(compile && errors_count > 0) {
+        fprintf(stderr, "ERROR: compile needs a table evaluating without errors\n");
+        exit(1);
+    }
 
-    // Dump a table into a binary for the future
-    expr_buffer_dump(dump_file, &eb, 0);
+    if(compile) {
+        aot_emit_table(out_file, &table, &eb, &graph);
+    } else if(cells_list) {
+        render_cells(out_file, &table, ranges, ranges_count);
+    } else {
+        render_table(out_file, &table, shown);
+    }
 
-    free(col_widths);
     free(content);
-    free(table.cells);
-    free(eb.items);
+    free(patch_content);
+    free(ranges);
+    free(shown);
+    free(dirty);
+    state_free(&state);
+    table_free(&table);
+    expr_buffer_free(&eb);
+    cache_free(&cache);
+    free(cache_path);
+    bytecode_free(&bc);
+    dep_graph_free(&graph);
     free(tc.cstr);
 
     double elapsed_time = (double)(clock() - start_time) / CLOCKS_PER_SEC;